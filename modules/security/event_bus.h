@@ -0,0 +1,128 @@
+// modules/security/event_bus.h — lock-free event ring in POSIX shared memory
+// Republishes kernel events to any number of local readers (event_bus.py)
+// without a socket, a fork or an encoding step: a reader maps the segment
+// and copies fixed 32-byte slots out of it. Writers claim a slot with one
+// fetch_add and publish it with a per-slot sequence number (odd while
+// being written, 2*pos+2 once complete), so writing is wait-free and
+// several producers may share a bus. Readers keep their own cursor and
+// never block a writer: one that falls a whole lap behind skips ahead and
+// counts what it lost. Producers must not be preempted for a whole lap
+// mid-write; at the default 65536 slots that is never the case in practice.
+// Header-only like honeypot_maps.h.
+//
+// Segment layout (little-endian, mirrored in event_bus.py):
+//   0    char  magic[8]   "OCEVBUS1", written last at creation
+//   8    u32   version    EVENT_BUS_VERSION
+//   12   u32   slot_size  sizeof(event_bus_slot)
+//   16   u64   capacity   slots, a power of two
+//   64   u64   head       next position to claim, on its own cache line
+//   128  event_bus_slot[capacity]
+
+#ifndef OMNICLAW_EVENT_BUS_H
+#define OMNICLAW_EVENT_BUS_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#define EVENT_BUS_DEFAULT_NAME "/omniclaw_events"      // /dev/shm/omniclaw_events
+#define EVENT_BUS_VERSION 1
+
+// event_bus_record.source values.
+#define EVENT_BUS_HONEYPOT 1    // honeypot_event from the XDP program
+#define EVENT_BUS_SENTINEL 2    // reserved for the kernel-bridge sentinel
+
+struct event_bus_record {
+    uint64_t ts_ns;     // CLOCK_MONOTONIC
+    uint32_t src_ip;    // network order
+    uint16_t source;    // EVENT_BUS_*
+    uint16_t type;      // per source, e.g. HONEYPOT_EVENT_*
+    uint32_t count;
+    uint32_t weight;    // sampling weight, 1 when unsampled
+};
+
+struct event_bus_slot {
+    uint64_t         seq;
+    event_bus_record rec;
+};
+
+static_assert(sizeof(event_bus_slot) == 32, "event_bus.py hardcodes the slot layout");
+
+class event_bus {
+public:
+    event_bus() = default;
+    ~event_bus() {
+        if (base_)
+            munmap(base_, size_);
+    }
+
+    event_bus(const event_bus &) = delete;
+    event_bus &operator=(const event_bus &) = delete;
+
+    // Maps the segment, creating it if needed. An existing segment of the
+    // same capacity is reused as is, so readers survive a producer restart.
+    int open(const char *name, uint64_t capacity) {
+        if (!capacity || (capacity & (capacity - 1)))
+            return -EINVAL;
+        int fd = shm_open(name, O_RDWR | O_CREAT | O_CLOEXEC, 0640);
+        if (fd < 0)
+            return -errno;
+        size_ = kSlotsOffset + capacity * sizeof(event_bus_slot);
+        int err = 0;
+        struct stat st;
+        bool reuse = !fstat(fd, &st) && static_cast<size_t>(st.st_size) == size_;
+        if (!reuse && (ftruncate(fd, 0) || ftruncate(fd, static_cast<off_t>(size_))))
+            err = -errno;
+        void *p = err ? MAP_FAILED : mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (!err && p == MAP_FAILED)
+            err = -errno;
+        close(fd);
+        if (err)
+            return err;
+        base_ = static_cast<char *>(p);
+        slots_ = reinterpret_cast<event_bus_slot *>(base_ + kSlotsOffset);
+        mask_ = capacity - 1;
+        if (reuse && !memcmp(base_, kMagic, sizeof(kMagic)) &&
+            header<uint64_t>(kCapacityOffset) == capacity)
+            return 0;
+
+        // Fresh segment: readers ignore it until the magic appears.
+        memset(base_, 0, size_);
+        header<uint32_t>(kVersionOffset) = EVENT_BUS_VERSION;
+        header<uint32_t>(kSlotSizeOffset) = sizeof(event_bus_slot);
+        header<uint64_t>(kCapacityOffset) = capacity;
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        memcpy(base_, kMagic, sizeof(kMagic));
+        return 0;
+    }
+
+    void publish(const event_bus_record &rec) {
+        uint64_t pos = __atomic_fetch_add(&header<uint64_t>(kHeadOffset), 1, __ATOMIC_RELAXED);
+        event_bus_slot &slot = slots_[pos & mask_];
+        __atomic_store_n(&slot.seq, 2 * pos + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        slot.rec = rec;
+        __atomic_store_n(&slot.seq, 2 * pos + 2, __ATOMIC_RELEASE);
+    }
+
+private:
+    static constexpr char   kMagic[8] = {'O', 'C', 'E', 'V', 'B', 'U', 'S', '1'};
+    static constexpr size_t kVersionOffset = 8, kSlotSizeOffset = 12, kCapacityOffset = 16;
+    static constexpr size_t kHeadOffset = 64, kSlotsOffset = 128;
+
+    template <typename T>
+    T &header(size_t off) { return *reinterpret_cast<T *>(base_ + off); }
+
+    char           *base_ = nullptr;
+    size_t          size_ = 0;
+    event_bus_slot *slots_ = nullptr;
+    uint64_t        mask_ = 0;
+};
+
+#endif // OMNICLAW_EVENT_BUS_H
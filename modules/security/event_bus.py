@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""
+event_bus.py — Zero-copy reader for the shared-memory event bus.
+
+offender-controller republishes every honeypot event it drains from the
+kernel into a ring in /dev/shm (see event_bus.h for the layout and the
+publication protocol). This module maps that segment and copies records
+straight out of it: no subprocess, no socket, no JSON, just an 8-byte
+sequence check per slot. Readers never slow the producer down; a reader
+that falls a whole lap behind skips ahead and reports the gap in ``lost``.
+
+Usage::
+
+    bus = EventBus()                  # /dev/shm/omniclaw_events
+    while True:
+        for ev in bus.poll():
+            print(ev.src_ip, ev.type)
+        time.sleep(0.001)
+
+    python -m modules.security.event_bus   # print events as they arrive
+"""
+
+from __future__ import annotations
+
+import mmap
+import socket
+import struct
+import time
+from typing import NamedTuple
+
+DEFAULT_PATH = "/dev/shm/omniclaw_events"
+
+# Mirrors event_bus.h.
+_MAGIC = b"OCEVBUS1"
+_VERSION = 1
+_HEADER = struct.Struct("<8sIIQ")        # magic, version, slot_size, capacity
+_HEAD_OFFSET = 64
+_SLOTS_OFFSET = 128
+_SLOT_SIZE = 32
+_U64 = struct.Struct("<Q")
+_RECORD = struct.Struct("<QIHHII")       # ts_ns, src_ip, source, type, count, weight
+
+SOURCE_HONEYPOT = 1
+SOURCE_SENTINEL = 2
+
+# honeypot_event.type values (honeypot.h).
+HONEYPOT_EVENT_THRESHOLD = 1
+HONEYPOT_EVENT_INTEL_DROP = 2
+HONEYPOT_EVENT_SCAN = 3
+
+
+class Event(NamedTuple):
+    ts_ns: int       # CLOCK_MONOTONIC, comparable with time.monotonic_ns()
+    src_ip: str
+    source: int
+    type: int
+    count: int
+    weight: int
+
+
+class EventBus:
+    """Read-only view of the event ring with a private cursor."""
+
+    def __init__(self, path: str = DEFAULT_PATH, from_start: bool = False):
+        with open(path, "rb") as f:
+            self._mm = mmap.mmap(f.fileno(), 0, prot=mmap.PROT_READ)
+        magic, version, slot_size, capacity = _HEADER.unpack_from(self._mm, 0)
+        if magic != _MAGIC or version != _VERSION or slot_size != _SLOT_SIZE:
+            self._mm.close()
+            raise ValueError(f"{path} is not an event bus this reader understands")
+        self._capacity = capacity
+        self._mask = capacity - 1
+        head = self._head()
+        self._cursor = max(0, head - capacity) if from_start else head
+        self.lost = 0
+
+    def _head(self) -> int:
+        return _U64.unpack_from(self._mm, _HEAD_OFFSET)[0]
+
+    def poll(self, max_events: int = 4096) -> list:
+        """Return the events published since the last call, oldest first."""
+        head = self._head()
+        if head < self._cursor:              # producer re-created the segment
+            self._cursor = head
+        if head - self._cursor > self._capacity:
+            self.lost += head - self._cursor - self._capacity
+            self._cursor = head - self._capacity
+
+        out = []
+        mm, unpack_seq, unpack_rec = self._mm, _U64.unpack_from, _RECORD.unpack_from
+        while self._cursor < head and len(out) < max_events:
+            off = _SLOTS_OFFSET + (self._cursor & self._mask) * _SLOT_SIZE
+            want = 2 * self._cursor + 2
+            seq = unpack_seq(mm, off)[0]
+            if seq < want:
+                break                        # claimed but not yet complete
+            if seq == want:
+                rec = unpack_rec(mm, off + 8)
+                if unpack_seq(mm, off)[0] == want:
+                    ts, ip, source, typ, count, weight = rec
+                    out.append(Event(ts, socket.inet_ntoa(struct.pack("<I", ip)),
+                                     source, typ, count, weight))
+                    self._cursor += 1
+                    continue
+            # Overwritten by a later lap while we were behind.
+            self.lost += 1
+            self._cursor += 1
+        return out
+
+    def close(self):
+        self._mm.close()
+
+
+def main():
+    bus = EventBus()
+    while True:
+        for ev in bus.poll():
+            print(f"{ev.ts_ns} src={ev.src_ip} source={ev.source} type={ev.type} "
+                  f"count={ev.count} weight={ev.weight}")
+        time.sleep(0.001)
+
+
+if __name__ == "__main__":
+    main()
@@ -1,74 +1,835 @@
 // modules/security/honeypot.cpp — eBPF XDP SSH brute-force detector
 // Inspects TCP packets to port 22, counts per-IP attempts in LRU map.
-// When threshold exceeded, marks packet for userspace TPROXY redirection
-// to the shadow shell on port 2222.
+// The parsing and counting live in honeypot_core.h, shared with the
+// native replay tool honeypot_sim.cpp; this file binds them to the maps.
+// When threshold exceeded, flags the source in verdict_map; the sk_lookup
+// program below then hands its new SSH connections to the shadow shell
+// listening on port 2222. Every SSH frame it passes carries the verdict and
+// score in its XDP metadata for later TC programs (honeypot_meta.h).
+// SSH SYNs are also fingerprinted by their TCP/IP stack (fp_stats), so a
+// botnet running one tool can be rate-limited as a whole (fp_limits), and
+// each connection's client KEXINIT is hashed HASSH-style (flows,
+// hassh_stats) so known brute-force clients can be acted on in-kernel
+// (hassh_policy). Ahead of all that, TCP probes to any port are tracked per
+// source (scan_state); a source sweeping many ports or hosts is flagged as
+// a scanner and meets the shadow shell on its first SSH connection. A
+// global SSH SYN rate (syn_guard) tightens the per-source threshold and
+// samples new sources during distributed floods.
 //
-// Build: clang -O2 -target bpf -c honeypot.cpp -o honeypot.bpf.o
-// Load:  ip link set dev eth0 xdp obj honeypot.bpf.o sec xdp
+// Build: clang -O2 -target bpf -x c -c honeypot.cpp -o honeypot.bpf.o
+// Load:  honeypot-loader attach eth0 honeypot.bpf.o   (see honeypot_loader.cpp;
+//        it picks native XDP, TC or generic XDP per interface)
+//
+// attack_map is pinned by name under HONEYPOT_PIN_ROOT, so reloading a new
+// build keeps every counter. Changing the layout of a pinned map makes the
+// pinned copy incompatible; remove the pin first in that case. The size of
+// the counter table is not part of that layout: `honeypot-ctl resize`
+// swaps in a bigger one at runtime.
 
 #include <linux/bpf.h>
 #include <linux/if_ether.h>
+#include <linux/in.h>
 #include <linux/ip.h>
 #include <linux/tcp.h>
+#include <linux/pkt_cls.h>
 #include <bpf/bpf_helpers.h>
 #include <bpf/bpf_endian.h>
 
-// LRU map: src_ip -> attempt count
+#include "honeypot.h"
+#include "honeypot_meta.h"
+
+// LRU map: src_ip -> attempt count within one epoch. Reached through the
+// attack_map holder (one slot per epoch, see HONEYPOT_EPOCHS) so
+// honeypot_ctl.cpp can rotate windows and migrate counters into larger
+// tables without a reload. attack_table_{0,1,2} are only the tables a fresh
+// pin starts with.
+struct attack_table {
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
+    __uint(max_entries, HONEYPOT_ATTACK_ENTRIES);
+    __type(key, __u32);
+    __type(value, __u32);
+};
+
+struct attack_table attack_table_0 SEC(".maps");
+struct attack_table attack_table_1 SEC(".maps");
+struct attack_table attack_table_2 SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY_OF_MAPS);
+    __uint(max_entries, HONEYPOT_EPOCHS);
+    __type(key, __u32);
+    __uint(pinning, LIBBPF_PIN_BY_NAME);
+    __array(values, struct attack_table);
+} attack_map SEC(".maps") = {
+    .values = { &attack_table_0, &attack_table_1, &attack_table_2 },
+};
+
+// Window control: a window reset is a single write of .epoch from
+// userspace, never a walk over the counters. Mmapable so that write and
+// one of .threshold are plain stores to their own fields
+// (honeypot_cfg_store() in honeypot_maps.h).
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, 1);
+    __uint(map_flags, BPF_F_MMAPABLE);
+    __type(key, __u32);
+    __type(value, struct honeypot_config);
+    __uint(pinning, LIBBPF_PIN_BY_NAME);
+} honeypot_cfg SEC(".maps");
+
+// Threat-intel blocklist: a bloom filter screens every SSH source and only
+// its (rare) positives pay for the exact hash lookup. Both are reached
+// through single-slot map-in-map holders so threat_intel_loader.cpp can
+// build a complete new generation off to the side and publish it with one
+// pointer swap; the packet path never waits on a reload. An empty slot
+// means no feed is loaded.
+struct intel_bloom_inner {
+    __uint(type, BPF_MAP_TYPE_BLOOM_FILTER);
+    __uint(max_entries, 1);
+    __uint(map_extra, HONEYPOT_INTEL_BLOOM_HASHES);
+    __type(value, __u32);
+};
+
+struct intel_set_inner {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, 1);
+    __uint(map_flags, BPF_F_NO_PREALLOC);
+    __type(key, __u32);
+    __type(value, __u32);       // 1-based feed index, for attribution
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY_OF_MAPS);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __uint(pinning, LIBBPF_PIN_BY_NAME);
+    __array(values, struct intel_bloom_inner);
+} intel_bloom SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY_OF_MAPS);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __uint(pinning, LIBBPF_PIN_BY_NAME);
+    __array(values, struct intel_set_inner);
+} intel_set SEC(".maps");
+
+// Sources over the threshold: src_ip -> HONEYPOT_VERDICT_* flags. Written by
+// the XDP program, read by sk_lookup_shadow for every new connection.
 struct {
     __uint(type, BPF_MAP_TYPE_LRU_HASH);
-    __uint(max_entries, 1024);
+    __uint(max_entries, HONEYPOT_VERDICT_ENTRIES);
     __type(key, __u32);
     __type(value, __u32);
-} attack_map SEC(".maps");
+    __uint(pinning, LIBBPF_PIN_BY_NAME);
+} verdict_map SEC(".maps");
 
-#define SHADOW_PORT 2222
-#define THRESHOLD   5
+// Key 0: the shadow shell's listening socket, inserted by
+// `honeypot-loader shadow-socket`.
+struct {
+    __uint(type, BPF_MAP_TYPE_SOCKMAP);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, __u64);
+    __uint(pinning, LIBBPF_PIN_BY_NAME);
+} shadow_sock SEC(".maps");
 
-SEC("xdp")
-int xdp_ssh_redirect(struct xdp_md *ctx) {
-    void *data_end = (void *)(long)ctx->data_end;
-    void *data     = (void *)(long)ctx->data;
+// Threshold crossings, for offender_controller.cpp: it bans on the event
+// instead of waiting for its next verdict_map scan, and times each
+// mitigation from ts_ns. One ring per CPU, so producers on different RX
+// queues never contend on a shared ring's lock during a distributed flood.
+// honeypot-loader sizes the holder to the possible CPUs and fills every
+// slot; a CPU whose slot is empty loses its events, and the controller's
+// periodic scan still picks up those bans.
+struct event_ring {
+    __uint(type, BPF_MAP_TYPE_RINGBUF);
+    __uint(max_entries, HONEYPOT_EVENTS_BYTES);
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY_OF_MAPS);
+    __uint(max_entries, 1);         // set to the possible CPUs at load
+    __type(key, __u32);
+    __uint(pinning, LIBBPF_PIN_BY_NAME);
+    __array(values, struct event_ring);
+} honeypot_events SEC(".maps");
+
+// Per-CPU event path counters (struct honeypot_event_stats), so a stalled
+// consumer shows up as numbers rather than silence.
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct honeypot_event_stats);
+    __uint(pinning, LIBBPF_PIN_BY_NAME);
+} honeypot_event_stats SEC(".maps");
+
+// Operator allowlist: src_ip -> 1. Checked before anything else, so an
+// allowlisted source is never counted, flagged or dropped.
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, HONEYPOT_ALLOWLIST_ENTRIES);
+    __uint(map_flags, BPF_F_NO_PREALLOC);
+    __type(key, __u32);
+    __type(value, __u32);
+    __uint(pinning, LIBBPF_PIN_BY_NAME);
+} allowlist SEC(".maps");
+
+// Per-interface mode and threshold, written by honeypot-ctl iface. Keyed by
+// ingress ifindex: one program instance serves every interface it is
+// attached to, with one set of counters behind all of them.
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, HONEYPOT_IF_ENTRIES);
+    __type(key, __u32);
+    __type(value, struct honeypot_if_config);
+    __uint(pinning, LIBBPF_PIN_BY_NAME);
+} if_config SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_HASH);
+    __uint(max_entries, HONEYPOT_IF_ENTRIES);
+    __type(key, __u32);
+    __type(value, struct honeypot_if_stats);
+    __uint(pinning, LIBBPF_PIN_BY_NAME);
+} if_stats SEC(".maps");
+
+// SYN fingerprints (honeypot_core.h): counters per fingerprint id, and the
+// SYNs per second honeypot-ctl fp-limit allows a fingerprint. A botnet
+// sharing one tool is throttled by one fp_limits entry instead of one ban
+// per source address.
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
+    __uint(max_entries, HONEYPOT_FP_ENTRIES);
+    __type(key, __u32);
+    __type(value, struct honeypot_fp_stats);
+    __uint(pinning, LIBBPF_PIN_BY_NAME);
+} fp_stats SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, HONEYPOT_FP_LIMIT_ENTRIES);
+    __type(key, __u32);
+    __type(value, __u32);
+    __uint(pinning, LIBBPF_PIN_BY_NAME);
+} fp_limits SEC(".maps");
+
+// Client side of the SSH connections in progress (struct honeypot_flow), and
+// per client fingerprint (the KEXINIT hash) a counter and the action
+// honeypot-ctl hassh-policy set for it.
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
+    __uint(max_entries, HONEYPOT_FLOW_ENTRIES);
+    __type(key, struct honeypot_flow_key);
+    __type(value, struct honeypot_flow);
+    __uint(pinning, LIBBPF_PIN_BY_NAME);
+} flows SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
+    __uint(max_entries, HONEYPOT_HASSH_ENTRIES);
+    __type(key, __u32);
+    __type(value, struct honeypot_hassh_stats);
+    __uint(pinning, LIBBPF_PIN_BY_NAME);
+} hassh_stats SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, HONEYPOT_HASSH_POLICY_ENTRIES);
+    __type(key, __u32);
+    __type(value, __u32);
+    __uint(pinning, LIBBPF_PIN_BY_NAME);
+} hassh_policy SEC(".maps");
+
+// Port-scan detection: the ports and hosts each source probed in its
+// current window (struct honeypot_scan), and the thresholds honeypot-ctl
+// scan sets.
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
+    __uint(max_entries, HONEYPOT_SCAN_ENTRIES);
+    __type(key, __u32);
+    __type(value, struct honeypot_scan);
+    __uint(pinning, LIBBPF_PIN_BY_NAME);
+} scan_state SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct honeypot_scan_config);
+    __uint(pinning, LIBBPF_PIN_BY_NAME);
+} scan_cfg SEC(".maps");
+
+// SYN-flood guard: each CPU counts SSH SYNs in its own slot and hands them
+// to the shared syn_guard once per tick, so the rate costs one atomic per
+// CPU per tick rather than one per SYN. The sources its lot turns away
+// are counted per CPU too. honeypot-ctl guard sets syn_guard_cfg.
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct honeypot_guard_cpu);
+    __uint(pinning, LIBBPF_PIN_BY_NAME);
+} syn_guard_cpu SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct honeypot_guard);
+    __uint(pinning, LIBBPF_PIN_BY_NAME);
+} syn_guard SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct honeypot_guard_config);
+    __uint(pinning, LIBBPF_PIN_BY_NAME);
+} syn_guard_cfg SEC(".maps");
+
+#ifndef AF_INET
+#define AF_INET 2
+#endif
+
+// tcx verdicts (linux/bpf.h from 6.6). TCX_NEXT hands the packet to the
+// next program on the link, where TC_ACT_OK would end the chain; on a
+// cls_bpf filter it is TC_ACT_UNSPEC and runs the next filter likewise.
+#ifndef TCX_NEXT
+#define TCX_NEXT (-1)
+#endif
+
+// Under pressure the consumer must fall behind gracefully: the fuller the
+// ring, the fewer non-critical events are posted (1-in-2 from a quarter
+// full, doubling per eighth, none from three quarters), which keeps the
+// remaining space for flaggings. The cost per call is a ring
+// query and at most one reserve, whatever the consumer does.
+static __always_inline void post_event(__u32 type, __u32 src_ip, __u32 count) {
+    __u32 zero = 0;
+    struct honeypot_event_stats *st = bpf_map_lookup_elem(&honeypot_event_stats, &zero);
+    if (!st)
+        return;
+    __u32 cpu = bpf_get_smp_processor_id();
+    void *ring = bpf_map_lookup_elem(&honeypot_events, &cpu);
+    if (!ring) {
+        if (HONEYPOT_EVENT_CRITICAL(type))
+            st->critical_lost++;
+        else
+            st->ring_full++;
+        return;
+    }
+
+    __u32 weight = 1;
+    if (!HONEYPOT_EVENT_CRITICAL(type)) {
+        __u64 eighths = bpf_ringbuf_query(ring, BPF_RB_AVAIL_DATA) * 8 / HONEYPOT_EVENTS_BYTES;
+        if (eighths >= 6) {
+            st->sampled_out++;
+            return;
+        }
+        if (eighths >= 2) {
+            weight = 1u << (eighths - 1);
+            if (st->seq++ & (weight - 1)) {
+                st->sampled_out++;
+                return;
+            }
+        }
+    }
+
+    struct honeypot_event *ev = bpf_ringbuf_reserve(ring, sizeof(*ev), 0);
+    if (!ev) {
+        if (HONEYPOT_EVENT_CRITICAL(type))
+            st->critical_lost++;
+        else
+            st->ring_full++;
+        return;
+    }
+    ev->ts_ns = bpf_ktime_get_ns();
+    ev->src_ip = src_ip;
+    ev->type = type;
+    ev->count = count;
+    ev->weight = weight;
+    bpf_ringbuf_submit(ev, 0);
+    st->posted++;
+}
+
+static __always_inline int intel_blocked(__u32 src_ip) {
+    __u32 zero = 0;
+    void *bloom = bpf_map_lookup_elem(&intel_bloom, &zero);
+    // peek returns 0 for "maybe present", -ENOENT for "definitely not".
+    if (!bloom || bpf_map_peek_elem(bloom, &src_ip))
+        return 0;
+    void *set = bpf_map_lookup_elem(&intel_set, &zero);
+    return set && bpf_map_lookup_elem(set, &src_ip);
+}
+
+// Map access for honeypot_core.h. Every hook reaches the maps above
+// directly, so the compiled program is the same as with the logic written
+// out inline; the policy only carries the ingress interface's counters.
+struct honeypot_policy {
+    struct honeypot_if_stats *stats;    // NULL once if_stats is full
+};
+
+static __always_inline int hp_allowed(struct honeypot_policy *p, __u32 src_ip) {
+    return !!bpf_map_lookup_elem(&allowlist, &src_ip);
+}
+
+static __always_inline int hp_intel_blocked(struct honeypot_policy *p, __u32 src_ip) {
+    return intel_blocked(src_ip);
+}
 
-    // -- Ethernet --
-    struct ethhdr *eth = data;
-    if ((void *)(eth + 1) > data_end)
+static __always_inline const struct honeypot_config *hp_config(struct honeypot_policy *p) {
+    __u32 zero = 0;
+    return bpf_map_lookup_elem(&honeypot_cfg, &zero);
+}
+
+static __always_inline __u32 hp_peek_count(struct honeypot_policy *p, __u32 slot, __u32 src_ip) {
+    void *table = bpf_map_lookup_elem(&attack_map, &slot);
+    if (!table)
+        return 0;
+    __u32 *count = bpf_map_lookup_elem(table, &src_ip);
+    return count ? *count : 0;
+}
+
+static __always_inline int hp_bump_count(struct honeypot_policy *p, __u32 slot, __u32 src_ip,
+                                         __u32 *after) {
+    void *table = bpf_map_lookup_elem(&attack_map, &slot);
+    if (!table)
+        return -1;
+    __u32 *count = bpf_map_lookup_elem(table, &src_ip);
+    if (count) {
+        __sync_fetch_and_add(count, 1);
+        *after = *count;
+    } else {
+        __u32 init = 1;
+        bpf_map_update_elem(table, &src_ip, &init, BPF_ANY);
+        *after = init;
+    }
+    return 0;
+}
+
+static __always_inline int hp_flag(struct honeypot_policy *p, __u32 src_ip) {
+    if (bpf_map_lookup_elem(&verdict_map, &src_ip))
+        return 0;
+    __u32 flags = HONEYPOT_VERDICT_SHADOW;
+    bpf_map_update_elem(&verdict_map, &src_ip, &flags, BPF_ANY);
+    if (p->stats)
+        p->stats->flagged++;
+    return 1;
+}
+
+static __always_inline void hp_post(struct honeypot_policy *p, __u32 type, __u32 src_ip,
+                                    __u32 count) {
+    post_event(type, src_ip, count);
+}
+
+static __always_inline int hp_guard(struct honeypot_policy *p, struct honeypot_guard_view *v) {
+    __u32 zero = 0;
+    const struct honeypot_guard_config *cfg = bpf_map_lookup_elem(&syn_guard_cfg, &zero);
+    struct honeypot_guard *g = bpf_map_lookup_elem(&syn_guard, &zero);
+    struct honeypot_guard_cpu *c = bpf_map_lookup_elem(&syn_guard_cpu, &zero);
+    if (!g || (cfg && cfg->off))
+        return 0;
+    // No tick folded for a while means no SYNs: the flood is over even if
+    // nothing has lowered the rate yet.
+    if (bpf_ktime_get_ns() - g->tick_ns < HONEYPOT_GUARD_STALE * HONEYPOT_GUARD_TICK_NS)
+        v->rate = g->rate;
+    v->baseline = cfg && cfg->baseline ? cfg->baseline : HONEYPOT_GUARD_BASELINE;
+    v->floor = cfg && cfg->floor ? cfg->floor : HONEYPOT_GUARD_FLOOR;
+    v->rnd = bpf_get_prandom_u32();
+    if (c)
+        v->not_admitted = &c->not_admitted;
+    return 1;
+}
+
+#include "honeypot_core.h"
+
+static __always_inline struct honeypot_if_stats *interface_stats(__u32 ifindex) {
+    struct honeypot_if_stats *st = bpf_map_lookup_elem(&if_stats, &ifindex);
+    if (st)
+        return st;
+    struct honeypot_if_stats zero = {};
+    bpf_map_update_elem(&if_stats, &ifindex, &zero, BPF_NOEXIST);
+    return bpf_map_lookup_elem(&if_stats, &ifindex);
+}
+
+// Counts one SSH SYN against its fingerprint. 1 when fp_limits caps the
+// fingerprint and this SYN is over the cap in the current second; only an
+// enforcing interface (enforce) drops it.
+static __always_inline int fingerprint_throttled(const struct honeypot_syn_fp *fp, int enforce) {
+    __u32 id = honeypot_fp_id(fp);
+    struct honeypot_fp_stats *st = bpf_map_lookup_elem(&fp_stats, &id);
+    if (!st) {
+        struct honeypot_fp_stats init = { .sig = *fp };
+        bpf_map_update_elem(&fp_stats, &id, &init, BPF_NOEXIST);
+        st = bpf_map_lookup_elem(&fp_stats, &id);
+        if (!st)
+            return 0;
+    }
+    __sync_fetch_and_add(&st->syns, 1);
+
+    __u32 *limit = bpf_map_lookup_elem(&fp_limits, &id);
+    if (!limit)
+        return 0;
+    // One-second window; a reset racing another CPU loses a few SYNs of
+    // the count, never lets a whole second through.
+    __u64 now = bpf_ktime_get_ns();
+    if (now - st->win_start_ns >= 1000000000ull) {
+        st->win_start_ns = now;
+        st->win_syns = 0;
+    }
+    __sync_fetch_and_add(&st->win_syns, 1);
+    if (st->win_syns <= *limit || !enforce)
+        return 0;
+    __sync_fetch_and_add(&st->throttled, 1);
+    return 1;
+}
+
+// Port-scan stage: hashes a probe's destination port and host into the
+// source's bitmaps. A source covering max_ports ports or max_hosts hosts
+// within one window is flagged like a brute-forcer, with
+// HONEYPOT_VERDICT_SCAN recording why. Bits are set without atomics: two
+// CPUs setting one bit at once count it twice, which at worst flags a
+// scanner a probe early. During a SYN flood a source new to scan_state
+// gets an entry only by the guard's lot, as in attack_map, so spoofed
+// sources cannot churn the table.
+static __always_inline void scan_step(struct honeypot_policy *policy, __u32 src_ip, __u32 dst_ip,
+                                      __u16 dport, const struct honeypot_if_config *ifc) {
+    __u32 zero = 0;
+    const struct honeypot_scan_config *cfg = bpf_map_lookup_elem(&scan_cfg, &zero);
+    __u32 mode = ifc ? ifc->mode : HONEYPOT_IF_ENFORCE;
+    if ((cfg && cfg->off) || mode == HONEYPOT_IF_BYPASS)
+        return;
+    __u64 window_ns = (__u64)(cfg && cfg->window_s ? cfg->window_s : HONEYPOT_SCAN_WINDOW_S) *
+                      1000000000ull;
+    __u32 max_ports = cfg && cfg->max_ports ? cfg->max_ports : HONEYPOT_SCAN_MAX_PORTS;
+    __u32 max_hosts = cfg && cfg->max_hosts ? cfg->max_hosts : HONEYPOT_SCAN_MAX_HOSTS;
+
+    __u64 now = bpf_ktime_get_ns();
+    struct honeypot_scan *sc = bpf_map_lookup_elem(&scan_state, &src_ip);
+    if (!sc) {
+        struct honeypot_guard_view guard = {};
+        if (hp_guard(policy, &guard) && !honeypot_guard_admit(&guard))
+            return;
+        struct honeypot_scan init = { .window_ns = now };
+        bpf_map_update_elem(&scan_state, &src_ip, &init, BPF_NOEXIST);
+        sc = bpf_map_lookup_elem(&scan_state, &src_ip);
+        if (!sc)
+            return;
+    }
+    if (now - sc->window_ns >= window_ns) {
+        __builtin_memset(sc, 0, sizeof(*sc));
+        sc->window_ns = now;
+    }
+
+    // Fibonacci hashing: the top bits spread neighbouring ports and
+    // addresses over the whole map.
+    __u32 pb = ((__u32)dport * 0x9e3779b1u) >> 24;
+    __u32 hb = (bpf_ntohl(dst_ip) * 0x9e3779b1u) >> 25;
+    __u64 *pw = &sc->ports[(pb >> 6) & 3];
+    __u64 *hw = &sc->hosts[(hb >> 6) & 1];
+    int grew = 0;
+    if (!(*pw & (1ull << (pb & 63)))) {
+        *pw |= 1ull << (pb & 63);
+        __sync_fetch_and_add(&sc->nports, 1);
+        grew = 1;
+    }
+    if (!(*hw & (1ull << (hb & 63)))) {
+        *hw |= 1ull << (hb & 63);
+        __sync_fetch_and_add(&sc->nhosts, 1);
+        grew = 1;
+    }
+    if (!grew || (sc->nports < max_ports && sc->nhosts < max_hosts))
+        return;
+    if (mode != HONEYPOT_IF_ENFORCE || bpf_map_lookup_elem(&allowlist, &src_ip))
+        return;
+
+    // Only the first probe over the line flags; later ones find the entry.
+    __u32 flags = HONEYPOT_VERDICT_SHADOW | HONEYPOT_VERDICT_SCAN;
+    if (bpf_map_update_elem(&verdict_map, &src_ip, &flags, BPF_NOEXIST))
+        return;
+    if (policy->stats)
+        policy->stats->flagged++;
+    post_event(HONEYPOT_EVENT_SCAN, src_ip, sc->nports > sc->nhosts ? sc->nports : sc->nhosts);
+}
+
+// Counts one SSH SYN towards the global rate. A CPU whose tick is over
+// hands its count to syn_guard; the first to find the shared tick over
+// folds it into the EWMA. Two CPUs racing there both fold, the second
+// with next to nothing pending: one extra decay step, no SYN lost.
+static __always_inline void guard_syn(void) {
+    __u32 zero = 0;
+    struct honeypot_guard_cpu *c = bpf_map_lookup_elem(&syn_guard_cpu, &zero);
+    struct honeypot_guard *g = bpf_map_lookup_elem(&syn_guard, &zero);
+    if (!c || !g)
+        return;
+    c->syns++;
+    __u64 now = bpf_ktime_get_ns();
+    if (now - c->tick_ns < HONEYPOT_GUARD_TICK_NS)
+        return;
+    __sync_fetch_and_add(&g->pending, c->syns);
+    c->syns = 0;
+    c->tick_ns = now;
+
+    __u64 start = g->tick_ns;
+    if (now - start < HONEYPOT_GUARD_TICK_NS)
+        return;
+    g->tick_ns = now;
+    __u64 pending = g->pending;
+    __sync_fetch_and_add(&g->pending, -pending);
+    g->rate = honeypot_guard_ewma(g->rate, pending, now - start);
+}
+
+// What detect() learnt about a frame, for the steps after it.
+struct detect_state {
+    struct honeypot_meta meta;          // magic set only for SSH frames
+    struct honeypot_policy policy;
+    const struct honeypot_if_config *ifc;
+    int enforce;                        // ingress interface enforces
+    int deferred;                       // screened, count left to the flow step
+    int attempt;                        // the flow step's estimate
+};
+
+// Both hooks: parse, count, decide, with the settings and counters of the
+// interface the frame arrived on. Returns an XDP action.
+static __always_inline int detect(__u32 ifindex, void *data, void *data_end,
+                                  struct detect_state *st) {
+    struct honeypot_if_stats *stats = interface_stats(ifindex);
+    st->policy.stats = stats;
+    if (stats)
+        stats->packets++;
+
+    // Probes to any port feed the scan stage first.
+    __u32 probe_src, probe_dst;
+    __u16 probe_port;
+    int probe = honeypot_parse_probe(data, data_end, &probe_src, &probe_dst, &probe_port);
+    if (probe) {
+        st->ifc = bpf_map_lookup_elem(&if_config, &ifindex);
+        scan_step(&st->policy, probe_src, probe_dst, probe_port, st->ifc);
+    }
+
+    __u32 src_ip;
+    if (!honeypot_parse(data, data_end, &src_ip))
         return XDP_PASS;
-    if (bpf_ntohs(eth->h_proto) != ETH_P_IP)
+    if (stats)
+        stats->ssh++;
+
+    // A SYN is one attempt and is counted here. Whether another segment is
+    // one only inspect_flow() can tell, so its count waits for that.
+    struct honeypot_syn_fp fp;
+    int syn = honeypot_syn_fingerprint(data, data_end, &fp);
+    if (syn)
+        guard_syn();
+    if (!probe)
+        st->ifc = bpf_map_lookup_elem(&if_config, &ifindex);
+    st->enforce = !st->ifc || st->ifc->mode == HONEYPOT_IF_ENFORCE;
+    int action = honeypot_screen(&st->policy, src_ip, st->ifc, &st->meta);
+    if (action == HONEYPOT_SCREENED && syn) {
+        action = honeypot_count(&st->policy, src_ip, st->ifc, &st->meta, 1);
+    } else if (action == HONEYPOT_SCREENED) {
+        st->deferred = 1;
+        action = XDP_PASS;
+    }
+
+    // SYNs of sources that are not exempt also count for their stack's
+    // fingerprint, which may be throttled as a whole.
+    if (action == XDP_PASS && syn && !(st->meta.flags & HONEYPOT_META_ALLOWED) &&
+        fingerprint_throttled(&fp, st->enforce))
+        action = XDP_DROP;
+    if (action == XDP_DROP && stats)
+        stats->dropped++;
+    return action;
+}
+
+// The client fingerprint of a flow just completed: counts it and fixes
+// the flow's policy.
+static __always_inline void flow_kexed(struct honeypot_flow *flow, __u32 src_ip,
+                                       struct detect_state *st) {
+    struct honeypot_hassh_stats *hs = bpf_map_lookup_elem(&hassh_stats, &flow->hassh);
+    if (!hs) {
+        struct honeypot_hassh_stats init = {};
+        bpf_map_update_elem(&hassh_stats, &flow->hassh, &init, BPF_NOEXIST);
+        hs = bpf_map_lookup_elem(&hassh_stats, &flow->hassh);
+    }
+    if (hs) {
+        __sync_fetch_and_add(&hs->flows, 1);
+        hs->last_ns = bpf_ktime_get_ns();
+    }
+
+    __u32 *policy = bpf_map_lookup_elem(&hassh_policy, &flow->hassh);
+    flow->policy = policy ? *policy : 0;
+    if ((flow->policy & HONEYPOT_HASSH_SHADOW) && st->enforce) {
+        __u32 flags = HONEYPOT_VERDICT_SHADOW;
+        if (!bpf_map_update_elem(&verdict_map, &src_ip, &flags, BPF_NOEXIST) && st->policy.stats)
+            st->policy.stats->flagged++;
+    }
+}
+
+static __always_inline int flow_action(const struct honeypot_flow *flow, struct detect_state *st) {
+    if (flow->state != HONEYPOT_FLOW_KEXED || !(flow->policy & HONEYPOT_HASSH_DROP) || !st->enforce)
         return XDP_PASS;
+    if (st->policy.stats)
+        st->policy.stats->dropped++;
+    return XDP_DROP;
+}
 
-    // -- IPv4 --
-    struct iphdr *ip = data + sizeof(*eth);
-    if ((void *)(ip + 1) > data_end)
+// After detect(), on frames it passed: follows the client side of SSH
+// connections. The identification line opens a flow, the KEXINIT after it
+// yields the client fingerprint (hassh), counted and matched against
+// hassh_policy once per connection, and the segments after that estimate
+// the authentication attempts made on it (honeypot_auth_step()) and sets
+// st->attempt for count_deferred(). FIN or RST closes the flow. One flow
+// lookup per segment. Returns an XDP action, or -1 when the payload it
+// needs is not in the linear area, with nothing changed yet.
+static __always_inline int inspect_flow(void *data, void *data_end, struct detect_state *st) {
+    if (!st->meta.magic || (st->meta.flags & HONEYPOT_META_ALLOWED))
         return XDP_PASS;
-    if (ip->protocol != IPPROTO_TCP)
+    struct honeypot_flow_key key;
+    __u32 off, len, seq;
+    int fin;
+    if (!honeypot_parse_segment(data, data_end, &key, &off, &len, &seq, &fin))
         return XDP_PASS;
-
-    // -- TCP --
-    struct tcphdr *tcp = (void *)ip + (ip->ihl * 4);
-    if ((void *)(tcp + 1) > data_end)
+    struct honeypot_flow *flow = bpf_map_lookup_elem(&flows, &key);
+    if (fin) {
+        if (flow)
+            bpf_map_delete_elem(&flows, &key);
         return XDP_PASS;
+    }
+    const __u8 *payload = (const __u8 *)data + (off & 0xff);
+    int kexed, r;
 
-    // Only SSH (port 22)
-    if (bpf_ntohs(tcp->dest) != 22)
-        return XDP_PASS;
+    if (!flow) {
+        // Connections already running when the program was loaded never
+        // show an identification line and are not followed.
+        struct honeypot_flow fresh = {};
+        r = honeypot_flow_open(&fresh, payload, data_end, len, seq, &kexed);
+        if (r == HONEYPOT_KEX_SHORT)
+            return -1;
+        if (r <= 0)
+            return XDP_PASS;
+        if (kexed)
+            flow_kexed(&fresh, key.saddr, st);
+        bpf_map_update_elem(&flows, &key, &fresh, BPF_NOEXIST);
+        return flow_action(&fresh, st);
+    }
 
-    __u32 src_ip = ip->saddr;
-    __u32 *count = bpf_map_lookup_elem(&attack_map, &src_ip);
-    if (count) {
-        __sync_fetch_and_add(count, 1);
-        if (*count > THRESHOLD) {
-            // Packet is from a repeat offender.
-            // Userspace iptables_helper.py reads attack_map via bpftool
-            // and inserts TPROXY rules to redirect to shadow shell port 2222.
-            // XDP cannot do TPROXY directly, but we let it pass so the
-            // TPROXY rule in the mangle table handles redirection.
+    r = honeypot_flow_segment(flow, payload, data_end, len, seq, &kexed);
+    if (r == HONEYPOT_KEX_SHORT)
+        return -1;
+    if (kexed)
+        flow_kexed(flow, key.saddr, st);
+    st->attempt = r > 0;
+    return flow_action(flow, st);
+}
+
+// Counts the segment detect() screened, once inspect_flow() has passed it
+// (action) and said whether it is an attempt: one count per frame. A flow
+// that is not followed only reads the count.
+static __always_inline int count_deferred(struct detect_state *st, int action) {
+    if (action < 0)
+        action = XDP_PASS;
+    if (action != XDP_PASS || !st->deferred)
+        return action;
+    return honeypot_count(&st->policy, st->meta.src_ip, st->ifc, &st->meta, st->attempt);
+}
+
+// Run configuration read by the libxdp dispatcher (honeypot-dispatch) when
+// xdp_ssh_redirect shares the XDP hook with other programs: an early slot,
+// so it counts SSH before a load balancer consumes the packet with XDP_TX
+// or XDP_REDIRECT, and the next program runs whenever this one passes.
+// honeypot-dispatch --priority / --chain override both at attach time.
+// Invisible to a plain bpf_link attach.
+#ifndef XDP_RUN_CONFIG
+#define XDP_RUN_CONFIG(f) _##f SEC(".xdp_run_config")      // as in xdp/xdp_helpers.h
+#endif
+
+struct {
+    __uint(priority, HONEYPOT_XDP_RUN_PRIO);
+    __uint(XDP_PASS, 1);
+} XDP_RUN_CONFIG(xdp_ssh_redirect);
+
+SEC("xdp")
+int xdp_ssh_redirect(struct xdp_md *ctx) {
+    void *data_end = (void *)(long)ctx->data_end;
+    void *data     = (void *)(long)ctx->data;
+    struct detect_state st = {};
+    int action = detect(ctx->ingress_ifindex, data, data_end, &st);
+    if (action == XDP_PASS) {
+        // A multi-buffer frame's payload is out of reach (-1): counted
+        // without the flow.
+        action = count_deferred(&st, inspect_flow(data, data_end, &st));
+    }
+    // Hand the outcome to the hooks after us (honeypot_meta.h).
+    if (action == XDP_PASS && st.meta.magic)
+        honeypot_meta_store(ctx, &st.meta);
+    return action;
+}
+
+// The same detector on the TC ingress hook, for drivers without native
+// XDP: there generic XDP builds the skb anyway and then runs the program
+// on a copy of its head, while TC works on the skb directly. Shares every
+// map with xdp_ssh_redirect; honeypot-loader attaches one or the other per
+// interface.
+SEC("tc")
+int tc_ssh_detect(struct __sk_buff *skb) {
+    // Already counted by xdp_ssh_redirect, as when honeypot-dispatch runs
+    // it in the XDP hook of an interface that also has this program.
+    if (honeypot_meta_skb(skb))
+        return TCX_NEXT;
+
+    // The headers can sit in paged data; pull them into the linear area,
+    // no further than the frame goes (a bare SYN is shorter than that).
+    if (skb->data + HONEYPOT_PARSE_BYTES > skb->data_end)
+        bpf_skb_pull_data(skb, skb->len < HONEYPOT_PARSE_BYTES ? skb->len : HONEYPOT_PARSE_BYTES);
+
+    void *data_end = (void *)(long)skb->data_end;
+    void *data     = (void *)(long)skb->data;
+    struct detect_state st = {};
+    int action = detect(skb->ifindex, data, data_end, &st);
+    if (action == XDP_PASS) {
+        action = inspect_flow(data, data_end, &st);
+        if (action < 0) {
+            // The client's first payloads are read whole: pull them in
+            // and look again.
+            __u32 want = HONEYPOT_PARSE_BYTES + HONEYPOT_KEX_SPAN;
+            bpf_skb_pull_data(skb, skb->len < want ? skb->len : want);
+            data_end = (void *)(long)skb->data_end;
+            data     = (void *)(long)skb->data;
+            action = inspect_flow(data, data_end, &st);
         }
-    } else {
-        __u32 init = 1;
-        bpf_map_update_elem(&attack_map, &src_ip, &init, BPF_ANY);
+        action = count_deferred(&st, action);
     }
+    return action == XDP_DROP ? TC_ACT_SHOT : TCX_NEXT;
+}
+
+// Runs when the stack looks up a listener for a new connection. Flagged
+// sources connecting to port 22 get the shadow shell's socket instead, with
+// no NAT, no conntrack entry and no per-source rule: one hash lookup per
+// connection however many offenders are flagged. A flag set on one
+// interface is global, so the mode of the interface the connection arrives
+// on decides here: only enforcing interfaces steer (ingress_ifindex needs
+// Linux 5.17).
+SEC("sk_lookup")
+int sk_lookup_shadow(struct bpf_sk_lookup *ctx) {
+    if (ctx->family != AF_INET || ctx->protocol != IPPROTO_TCP ||
+        ctx->local_port != HONEYPOT_SSH_PORT)
+        return SK_PASS;
+
+    __u32 src_ip = ctx->remote_ip4;
+    __u32 *verdict = bpf_map_lookup_elem(&verdict_map, &src_ip);
+    if (!verdict || !(*verdict & HONEYPOT_VERDICT_SHADOW))
+        return SK_PASS;
+    __u32 ifindex = ctx->ingress_ifindex;
+    const struct honeypot_if_config *ifc = bpf_map_lookup_elem(&if_config, &ifindex);
+    if (ifc && ifc->mode != HONEYPOT_IF_ENFORCE)
+        return SK_PASS;
 
-    return XDP_PASS;
+    __u32 zero = 0;
+    struct bpf_sock *sk = bpf_map_lookup_elem(&shadow_sock, &zero);
+    if (!sk)
+        return SK_PASS;        // shadow shell not registered: normal sshd
+    bpf_sk_assign(ctx, sk, 0);
+    bpf_sk_release(sk);
+    return SK_PASS;
 }
 
 char _license[] SEC("license") = "GPL";
@@ -0,0 +1,343 @@
+// modules/security/honeypot.h — definitions shared by honeypot.cpp and its
+// userspace tools. Kept free of libc so the BPF object can include it too.
+
+#ifndef OMNICLAW_HONEYPOT_H
+#define OMNICLAW_HONEYPOT_H
+
+#include <linux/types.h>
+
+// bpffs directory holding the pinned maps and per-interface XDP links.
+// Maps are pinned by name (LIBBPF_PIN_BY_NAME), so a reload of a newer
+// honeypot.bpf.o picks up the existing attack_map instead of a fresh one.
+#define HONEYPOT_PIN_ROOT  "/sys/fs/bpf/omniclaw"
+#define HONEYPOT_LINK_PFX  HONEYPOT_PIN_ROOT "/xdp_link_"
+#define HONEYPOT_ATTACK_MAP_PIN HONEYPOT_PIN_ROOT "/attack_map"
+#define HONEYPOT_CFG_PIN        HONEYPOT_PIN_ROOT "/honeypot_cfg"
+#define HONEYPOT_VERDICT_MAP_PIN HONEYPOT_PIN_ROOT "/verdict_map"
+#define HONEYPOT_SHADOW_SOCK_PIN HONEYPOT_PIN_ROOT "/shadow_sock"
+#define HONEYPOT_SK_LOOKUP_LINK  HONEYPOT_PIN_ROOT "/sk_lookup_link"
+#define HONEYPOT_INTEL_BLOOM_PIN HONEYPOT_PIN_ROOT "/intel_bloom"
+#define HONEYPOT_INTEL_SET_PIN   HONEYPOT_PIN_ROOT "/intel_set"
+#define HONEYPOT_EVENTS_PIN      HONEYPOT_PIN_ROOT "/honeypot_events"
+#define HONEYPOT_EVENT_STATS_PIN HONEYPOT_PIN_ROOT "/honeypot_event_stats"
+#define HONEYPOT_ALLOWLIST_PIN   HONEYPOT_PIN_ROOT "/allowlist"
+#define HONEYPOT_IF_CONFIG_PIN   HONEYPOT_PIN_ROOT "/if_config"
+#define HONEYPOT_IF_STATS_PIN    HONEYPOT_PIN_ROOT "/if_stats"
+#define HONEYPOT_FP_STATS_PIN    HONEYPOT_PIN_ROOT "/fp_stats"
+#define HONEYPOT_FP_LIMITS_PIN   HONEYPOT_PIN_ROOT "/fp_limits"
+#define HONEYPOT_FLOWS_PIN       HONEYPOT_PIN_ROOT "/flows"
+#define HONEYPOT_HASSH_STATS_PIN HONEYPOT_PIN_ROOT "/hassh_stats"
+#define HONEYPOT_HASSH_POLICY_PIN HONEYPOT_PIN_ROOT "/hassh_policy"
+#define HONEYPOT_SCAN_STATE_PIN  HONEYPOT_PIN_ROOT "/scan_state"
+#define HONEYPOT_SCAN_CFG_PIN    HONEYPOT_PIN_ROOT "/scan_cfg"
+#define HONEYPOT_GUARD_PIN       HONEYPOT_PIN_ROOT "/syn_guard"
+#define HONEYPOT_GUARD_CPU_PIN   HONEYPOT_PIN_ROOT "/syn_guard_cpu"
+#define HONEYPOT_GUARD_CFG_PIN   HONEYPOT_PIN_ROOT "/syn_guard_cfg"
+
+// Hash functions per bloom filter entry (map_extra). The kernel sizes the
+// bitset optimally for max_entries, giving ~2^-5 = 3% false positives;
+// every positive is confirmed against the exact set anyway.
+#define HONEYPOT_INTEL_BLOOM_HASHES 5
+
+#define HONEYPOT_PROG_NAME "xdp_ssh_redirect"
+#define HONEYPOT_TC_PROG "tc_ssh_detect"      // same detector on TC ingress
+
+// Default libxdp dispatcher slot of xdp_ssh_redirect; lower runs first,
+// libxdp's own default is 50.
+#define HONEYPOT_XDP_RUN_PRIO 20
+#define HONEYPOT_SK_LOOKUP_PROG "sk_lookup_shadow"
+
+// Port the real sshd listens on; the one the detector watches.
+#define HONEYPOT_SSH_PORT 22
+
+// Port the shadow shell (honeypot.py / shadow_shell.py) listens on.
+#define SHADOW_PORT 2222
+
+// verdict_map value flags.
+#define HONEYPOT_VERDICT_SHADOW  (1u << 0)   // steer SSH to the shadow shell
+#define HONEYPOT_VERDICT_SCAN    (1u << 1)   // reason: port scan (set with SHADOW)
+#define HONEYPOT_VERDICT_ENTRIES 65536
+
+// Sources in allowlist are never counted, flagged or dropped.
+#define HONEYPOT_ALLOWLIST_ENTRIES 4096
+
+// Attempts per window above which a source is flagged, unless
+// honeypot_config.threshold overrides it.
+#define HONEYPOT_DEFAULT_THRESHOLD 5
+
+// Size of each counter table a fresh attack_map starts with.
+#define HONEYPOT_ATTACK_ENTRIES 1024
+
+// attack_map holds one counter table per epoch. The program counts into
+// the current epoch and adds the previous one for a sliding estimate; the
+// third is the retired table, replaced by an empty one after each rotation
+// so it is clean by the time it becomes current again.
+#define HONEYPOT_EPOCHS 3
+
+// Size in bytes of each per-CPU ring in honeypot_events (power of two,
+// page multiple).
+#define HONEYPOT_EVENTS_BYTES (256 * 1024)
+#define HONEYPOT_EVENTS_MAP "honeypot_events"
+
+// honeypot_event.type values. Only flaggings are critical: they are never
+// sampled, and the last quarter of every ring is kept free for them.
+// Everything else is informational and sampled under pressure.
+#define HONEYPOT_EVENT_THRESHOLD  1     // source crossed the threshold, now flagged
+#define HONEYPOT_EVENT_INTEL_DROP 2     // packet dropped by the threat-intel blocklist
+#define HONEYPOT_EVENT_SCAN       3     // source flagged as a port scanner
+
+#define HONEYPOT_EVENT_CRITICAL(type) \
+    ((type) == HONEYPOT_EVENT_THRESHOLD || (type) == HONEYPOT_EVENT_SCAN)
+
+// Record the XDP program posts to its CPU's ring in honeypot_events. ts_ns is
+// bpf_ktime_get_ns(), i.e. CLOCK_MONOTONIC, so userspace can measure
+// time-to-mitigate against clock_gettime() directly.
+struct honeypot_event {
+    __u64 ts_ns;
+    __u32 src_ip;       // network order
+    __u32 type;
+    __u32 count;        // attempts in the window when the event fired
+    __u32 weight;       // 1-in-N sampling in force when posted; scale counts by it
+};
+
+// Per-CPU accounting of the event path (honeypot_event_stats, key 0).
+// Every event the program meant to post lands in exactly one of the first
+// four counters, so userspace sees drops exactly.
+struct honeypot_event_stats {
+    __u64 posted;           // submitted to the ring
+    __u64 sampled_out;      // non-critical, skipped by adaptive sampling
+    __u64 ring_full;        // non-critical, reserve failed
+    __u64 critical_lost;    // flagging, reserve failed; the
+                            // verdict_map flag is set regardless, so the
+                            // controller's scan still bans the source
+    __u64 seq;              // non-critical sequence number, drives 1-in-N
+};
+
+// Single entry (key 0) of the honeypot_cfg array map.
+// Userspace updates it read-modify-write, one field per writer.
+struct honeypot_config {
+    __u32 epoch;        // current slot of attack_map, advanced by honeypot-ctl rotate
+    __u32 threshold;    // 0: HONEYPOT_DEFAULT_THRESHOLD
+};
+
+// Interfaces if_config and if_stats can describe. One program instance
+// serves every interface it is attached to; these only label its packets.
+#define HONEYPOT_IF_ENTRIES 256
+
+// honeypot_if_config.mode values.
+#define HONEYPOT_IF_ENFORCE 0   // count, flag, drop threat-intel sources
+#define HONEYPOT_IF_MONITOR 1   // count only: never flags, drops or steers
+#define HONEYPOT_IF_BYPASS  2   // pass everything uncounted
+
+// Per-interface settings (if_config, key: ingress ifindex). Counts are
+// shared by all interfaces, so an offender spreading over uplinks is seen
+// whole; only the decision is per interface. Interfaces without an entry
+// enforce with the global threshold.
+struct honeypot_if_config {
+    __u32 mode;         // HONEYPOT_IF_*
+    __u32 threshold;    // 0: the one in honeypot_cfg
+};
+
+// Per-CPU counters per ingress interface (if_stats, key: ifindex).
+struct honeypot_if_stats {
+    __u64 packets;      // every frame the program ran on
+    __u64 ssh;          // TCP to HONEYPOT_SSH_PORT
+    __u64 flagged;      // sources this interface flagged (threshold, scan, hassh policy)
+    __u64 dropped;      // threat-intel and fingerprint-throttle drops
+};
+
+// SYN fingerprints fp_stats keeps counters for, and fingerprints fp_limits
+// can cap.
+#define HONEYPOT_FP_ENTRIES       4096
+#define HONEYPOT_FP_LIMIT_ENTRIES 256
+
+// TCP option kinds a fingerprint records, NOPs included. Common stacks
+// send five or six. A power of two.
+#define HONEYPOT_FP_MAX_OPTS 8
+
+// Passive fingerprint of the TCP/IP stack that sent a SYN: values the
+// client's OS or tool picks for itself, not ones the path rewrites. A
+// botnet running one tool shares one fingerprint across all its sources.
+struct honeypot_syn_fp {
+    __u16 window;       // host order
+    __u16 mss;          // 0: no MSS option
+    __u8  ttl;          // initial TTL: the one seen, rounded up to 32, 64, 128 or 255
+    __u8  wscale;       // 0xff: no window scale option
+    __u8  df;           // IP don't-fragment bit
+    __u8  nopts;        // kinds used in opts
+    __u8  opts[HONEYPOT_FP_MAX_OPTS];   // option kinds in the order sent
+};
+
+// fp_stats value; the key is the fingerprint id, honeypot_fp_id(&sig).
+// Shared by all CPUs: the rate window must see every SYN.
+struct honeypot_fp_stats {
+    struct honeypot_syn_fp sig;
+    __u64 syns;             // SSH SYNs seen with this fingerprint
+    __u64 throttled;        // of which dropped over the fp_limits rate
+    __u64 win_start_ns;     // current one-second rate window
+    __u64 win_syns;         // SYNs in it
+};
+
+// Outcome of the detector for one SSH frame. xdp_ssh_redirect leaves it in
+// the frame's XDP metadata area for the hooks after it, which read it with
+// honeypot_meta.h instead of repeating the lookups (20 bytes; the area
+// takes at most 32, in multiples of 4).
+#define HONEYPOT_META_MAGIC   0x48504d31u   // "HPM1"
+#define HONEYPOT_META_ALLOWED (1u << 0)     // allowlisted, or interface in bypass
+#define HONEYPOT_META_INTEL   (1u << 1)     // on a threat-intel feed (monitor mode)
+
+struct honeypot_meta {
+    __u32 magic;        // HONEYPOT_META_MAGIC
+    __u32 src_ip;       // network order
+    __u32 verdict;      // HONEYPOT_VERDICT_* decided on this frame; a source
+                        // flagged in an earlier window that is back under
+                        // the threshold shows 0 here but stays in verdict_map
+    __u32 score;        // attempts in the sliding window, this frame included
+    __u32 flags;        // HONEYPOT_META_*
+};
+
+// SSH connections the detector follows at once (flows), client
+// fingerprints it keeps counters for (hassh_stats), and fingerprints
+// hassh_policy can act on.
+#define HONEYPOT_FLOW_ENTRIES         65536
+#define HONEYPOT_HASSH_ENTRIES        4096
+#define HONEYPOT_HASSH_POLICY_ENTRIES 256
+
+// flows key: one direction of a TCP connection, client to server, all
+// fields in network order.
+struct honeypot_flow_key {
+    __u32 saddr;
+    __u32 daddr;
+    __u16 sport;
+    __u16 dport;
+};
+
+// Incremental read of the client's SSH_MSG_KEXINIT, which may span
+// segments: the hash of "kex;enc;mac;comp" (its client-to-server name
+// lists, as HASSH takes them) built as the lists go by.
+struct honeypot_kex_scan {
+    __u32 hash;         // FNV-1a so far
+    __u16 stage;        // 0: packet header next; 1 + n: in name-list n; 8: done
+    __u16 left;         // bytes of the current list still to come; 0: its length is next
+};
+
+// honeypot_flow.state values.
+#define HONEYPOT_FLOW_KEXINIT 0     // identification line seen, reading the KEXINIT
+#define HONEYPOT_FLOW_KEXED   1     // client fingerprint known
+#define HONEYPOT_FLOW_OPAQUE  2     // KEXINIT unreadable; flow not fingerprinted
+#define HONEYPOT_FLOW_SESSION 3     // authenticated, by its traffic; no longer estimated
+
+// hassh_policy value flags, per client fingerprint (the honeypot_flow.hassh
+// of flows). Applied on enforcing interfaces when the fingerprint of a new
+// connection becomes known.
+#define HONEYPOT_HASSH_SHADOW (1u << 0)   // flag the source: later connections go to the shadow shell
+#define HONEYPOT_HASSH_DROP   (1u << 1)   // drop the rest of this connection
+
+// flows value. Opened by the client's identification line, so only
+// connections that speak SSH take an entry; closed by FIN or RST, or
+// evicted (LRU).
+struct honeypot_flow {
+    __u32 state;        // HONEYPOT_FLOW_*
+    __u32 hassh;        // client fingerprint, once KEXED
+    __u32 policy;       // HONEYPOT_HASSH_* of hassh when it became known
+    __u32 next_seq;     // client sequence number the stream continues at
+    __u16 segments;     // client payload segments since the KEXINIT
+    __u8  requests;     // of which sized like a userauth request
+    __u8  pad;
+    struct honeypot_kex_scan kex;
+};
+
+// hassh_stats value (key: client fingerprint).
+struct honeypot_hassh_stats {
+    __u64 flows;        // connections that sent it
+    __u64 last_ns;      // bpf_ktime_get_ns() of the latest
+};
+
+// Port-scan detection: sources scan_state follows at once, and the
+// defaults of honeypot_scan_config.
+#define HONEYPOT_SCAN_ENTRIES    65536
+#define HONEYPOT_SCAN_WINDOW_S   60
+#define HONEYPOT_SCAN_MAX_PORTS  32
+#define HONEYPOT_SCAN_MAX_HOSTS  32
+
+// scan_state value (key: source address). Destination ports and hosts are
+// hashed into bitmaps; set bits stand for distinct values, slightly fewer
+// than the real count once bits collide.
+struct honeypot_scan {
+    __u64 window_ns;    // bpf_ktime_get_ns() the window began
+    __u64 ports[4];     // 256-bit map of destination ports
+    __u64 hosts[2];     // 128-bit map of destination addresses
+    __u32 nports;       // bits set in ports
+    __u32 nhosts;       // bits set in hosts
+};
+
+// Single entry (key 0) of scan_cfg; zeros pick the defaults above.
+struct honeypot_scan_config {
+    __u32 window_s;     // counting window per source
+    __u32 max_ports;    // distinct ports in a window that flag a source
+    __u32 max_hosts;    // distinct destination hosts likewise
+    __u32 off;          // nonzero: detection disabled
+};
+
+// SYN-flood guard: the global SSH SYN rate, as an EWMA in fixed point
+// (SYNs per second << HONEYPOT_GUARD_SHIFT) folded once per tick. Above
+// the baseline the per-source threshold shrinks in proportion, down to the
+// floor, and sources new to attack_map are admitted by lot.
+#define HONEYPOT_GUARD_TICK_NS   100000000ull   // 100 ms
+#define HONEYPOT_GUARD_STALE     8              // ticks without SYNs that reset the rate
+#define HONEYPOT_GUARD_SHIFT     4
+#define HONEYPOT_GUARD_EWMA      3              // weight 1/8 per tick
+#define HONEYPOT_GUARD_BASELINE  1000           // SSH SYNs per second
+#define HONEYPOT_GUARD_FLOOR     2
+
+// syn_guard_cpu value: this CPU's SYNs not yet handed to syn_guard, and
+// its share of the sources the lot turned away (honeypot-ctl guard sums
+// them).
+struct honeypot_guard_cpu {
+    __u64 tick_ns;
+    __u64 syns;
+    __u64 not_admitted;
+};
+
+// Single entry (key 0) of syn_guard, shared by every CPU.
+struct honeypot_guard {
+    __u64 tick_ns;      // start of the current tick
+    __u64 pending;      // SYNs the CPUs handed over this tick
+    __u64 rate;         // EWMA, SYNs/s << HONEYPOT_GUARD_SHIFT
+};
+
+// Single entry (key 0) of syn_guard_cfg; zeros pick the defaults above.
+struct honeypot_guard_config {
+    __u32 baseline;     // SSH SYNs per second the host takes as normal
+    __u32 floor;        // lowest effective threshold
+    __u32 off;          // nonzero: threshold and admission left alone
+    __u32 pad;
+};
+
+// The guard as a policy reports it to honeypot_decide() (hp_guard() in
+// honeypot_core.h).
+struct honeypot_guard_view {
+    __u64 rate;             // SYNs/s << HONEYPOT_GUARD_SHIFT, 0 when stale
+    __u32 baseline;
+    __u32 floor;
+    __u32 rnd;              // uniform random, for the admission lot
+    __u64 *not_admitted;    // this CPU's counter to bump, may be NULL
+};
+
+// dump_params of honeypot_iter.cpp (key 0), set by honeypot-dump before
+// each pass over one counter table.
+struct honeypot_dump_params {
+    __u32 other_slot;   // attack_map slot holding the other half of the window
+    __u32 skip_shared;  // second pass: drop sources the other table also has
+    __u32 min_count;    // 0: the threshold in force
+    __u32 pad;
+};
+
+// Binary output of honeypot-dump; the same layout as a honeypot-snapshot
+// record.
+struct honeypot_dump_record {
+    __u32 src_ip;       // network order
+    __u32 count;        // attempts in the window
+};
+
+#endif // OMNICLAW_HONEYPOT_H
@@ -0,0 +1,554 @@
+// modules/security/honeypot_capture.cpp — packet-socket fallback for the detector
+// For hosts that may not attach XDP (containers without the rights, drivers
+// that refuse it): reads the SSH traffic of an interface from PACKET_MMAP
+// TPACKET_V3 block rings and runs it through honeypot_core.h, the decision
+// code compiled into honeypot.bpf.o. One socket per worker thread, all in
+// one PACKET_FANOUT_HASH group, so the kernel spreads flows across the
+// workers without a copy between them. A classic BPF socket filter (no
+// CAP_BPF, no program load) keeps everything but IPv4 TCP to port 22 out
+// of the rings and truncates what it keeps to the headers.
+//
+// Verdicts go where the XDP program puts them: a newly flagged source is
+// written into the pinned verdict_map, which offender-controller scans
+// every --tick-ms, bans and expires exactly as for the kernel detector, and
+// which sk_lookup_shadow steers on if it is attached. Epoch and threshold
+// come from the pinned honeypot_cfg, so honeypot-ctl rotate and threshold
+// drive this engine too, and the allowlist and the interface's if_config
+// entry (monitor and bypass modes, its own threshold) are re-read every
+// --tick-ms.
+// With --bus the threshold events are also published on the event bus.
+//
+// Differences from the kernel path: a packet socket only observes, so
+// threat-intel sources cannot be dropped here and are counted like any
+// other; the counter tables are fixed-size (--entries per epoch) and
+// skip new sources when full instead of evicting the least recently used;
+// and the snapshot length keeps the client's KEXINIT out of reach, so
+// connections are not fingerprinted, though their authentication attempts
+// are still estimated from segment sizes.
+//
+// The maps must be pinned: `honeypot-loader attach` pins them at load,
+// before (and even when it is refused) the XDP attach.
+//
+// Build: clang++ -O2 -std=c++17 -pthread honeypot_capture.cpp -lbpf -o honeypot-capture
+// Usage: honeypot-capture <ifname> [--threads <n>] [--entries <n>] [--tick-ms <ms>]
+//                         [--ring-mb <n>] [--bus <shm-name>]
+//        as root, or with CAP_NET_RAW for the packet sockets plus write
+//        access to the pinned maps (CAP_BPF or ownership of the pins)
+
+#include <arpa/inet.h>
+#include <bpf/bpf.h>
+#include <bpf/bpf_endian.h>
+#include <linux/filter.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "event_bus.h"
+#include "honeypot.h"
+#include "honeypot_core.h"
+#include "honeypot_maps.h"
+
+#ifndef PACKET_IGNORE_OUTGOING
+#define PACKET_IGNORE_OUTGOING 23
+#endif
+
+namespace {
+
+// Ring geometry per worker: --ring-mb (4 by default) in blocks of 512 KiB,
+// each handed back to the kernel as a whole. Truncated to kSnapLen, a
+// packet takes about 200 bytes of a block, so 4 MiB holds some 20k: 100 ms
+// of 200 kpps per worker. A block is retired after 10 ms even when not full
+// so a trickle of SSH packets is not held back.
+constexpr unsigned kBlockSize = 512u << 10, kFrameSize = 2048, kBlockTimeoutMs = 10;
+constexpr unsigned kRingMb = 4;
+constexpr unsigned kSnapLen = 128;      // Ethernet + longest IPv4 header + TCP header
+constexpr unsigned kMaxProbe = 64;
+
+std::atomic<bool> g_stop{false};
+
+void on_signal(int) { g_stop.store(true); }
+
+uint64_t now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+// Fixed-capacity open-addressing table of src_ip -> u32 shared by all
+// workers without a lock: a key is claimed with one CAS, values are plain
+// atomics. 0.0.0.0 marks an empty slot and is never counted. Entries are
+// only removed by clear(), which races with writers the same way a slot
+// refresh by honeypot-ctl races with the XDP program.
+class shared_table {
+public:
+    explicit shared_table(size_t entries) {
+        size_t cap = 1;
+        while (cap < entries * 2)
+            cap <<= 1;
+        slots_ = std::make_unique<slot[]>(cap);
+        mask_ = cap - 1;
+    }
+
+    std::atomic<uint32_t> *find(uint32_t key) {
+        size_t i = hash(key);
+        for (unsigned n = 0; n < kMaxProbe; n++, i = (i + 1) & mask_) {
+            uint32_t k = slots_[i].key.load(std::memory_order_acquire);
+            if (k == key)
+                return &slots_[i].value;
+            if (!k)
+                return nullptr;
+        }
+        return nullptr;
+    }
+
+    // nullptr when the key is 0 or its probe window is full.
+    std::atomic<uint32_t> *find_or_insert(uint32_t key) {
+        if (!key)
+            return nullptr;
+        size_t i = hash(key);
+        for (unsigned n = 0; n < kMaxProbe; n++, i = (i + 1) & mask_) {
+            uint32_t k = slots_[i].key.load(std::memory_order_acquire);
+            if (!k && slots_[i].key.compare_exchange_strong(k, key, std::memory_order_acq_rel))
+                return &slots_[i].value;
+            if (k == key)
+                return &slots_[i].value;
+        }
+        return nullptr;
+    }
+
+    void clear() {
+        for (size_t i = 0; i <= mask_; i++) {
+            slots_[i].value.store(0, std::memory_order_relaxed);
+            slots_[i].key.store(0, std::memory_order_release);
+        }
+    }
+
+private:
+    struct slot {
+        std::atomic<uint32_t> key{0};
+        std::atomic<uint32_t> value{0};
+    };
+
+    size_t hash(uint32_t key) const {
+        return (static_cast<uint64_t>(key) * 0x9e3779b97f4a7c15ull >> 32) & mask_;
+    }
+
+    std::unique_ptr<slot[]> slots_;
+    size_t                  mask_ = 0;
+};
+
+using address_list = std::vector<uint32_t>;     // sorted
+
+// State shared by the workers; the main thread refreshes cfg, the
+// interface's if_config, allowlist and tick from the pins.
+struct capture_state {
+    explicit capture_state(size_t entries)
+        : tables{shared_table(entries), shared_table(entries), shared_table(entries)},
+          flag_cache(entries) {}
+
+    shared_table                        tables[HONEYPOT_EPOCHS];
+    shared_table                        flag_cache;     // src_ip -> tick last written to verdict_map
+    std::atomic<uint32_t>               epoch{0}, threshold{0}, tick{1};
+    std::atomic<uint32_t>               if_mode{HONEYPOT_IF_ENFORCE}, if_threshold{0};
+    std::shared_ptr<const address_list> allowlist = std::make_shared<address_list>();
+    int                                 verdict_fd = -1;
+    event_bus                          *bus = nullptr;
+};
+
+struct worker_stats {
+    std::atomic<uint64_t> packets{0}, flagged{0}, table_full{0};
+};
+
+// honeypot_core.h policy of one worker. cfg, ifc and allow are snapshots
+// taken once per ring block.
+struct capture_policy {
+    capture_state                      *s;
+    worker_stats                       *stats;
+    honeypot_config                     cfg;
+    honeypot_if_config                  ifc;
+    std::shared_ptr<const address_list> allow;
+
+    void refresh() {
+        cfg.epoch = s->epoch.load(std::memory_order_relaxed);
+        cfg.threshold = s->threshold.load(std::memory_order_relaxed);
+        ifc.mode = s->if_mode.load(std::memory_order_relaxed);
+        ifc.threshold = s->if_threshold.load(std::memory_order_relaxed);
+        allow = std::atomic_load(&s->allowlist);
+    }
+};
+
+int hp_allowed(capture_policy *p, __u32 src_ip) {
+    return std::binary_search(p->allow->begin(), p->allow->end(), src_ip);
+}
+
+// Dropping is not possible from a packet socket; see the file comment.
+int hp_intel_blocked(capture_policy *, __u32) { return 0; }
+
+const honeypot_config *hp_config(capture_policy *p) { return &p->cfg; }
+
+__u32 hp_peek_count(capture_policy *p, __u32 slot, __u32 src_ip) {
+    std::atomic<uint32_t> *count = p->s->tables[slot].find(src_ip);
+    return count ? count->load(std::memory_order_relaxed) : 0;
+}
+
+int hp_bump_count(capture_policy *p, __u32 slot, __u32 src_ip, __u32 *after) {
+    std::atomic<uint32_t> *count = p->s->tables[slot].find_or_insert(src_ip);
+    if (!count) {
+        p->stats->table_full.fetch_add(1, std::memory_order_relaxed);
+        return -1;
+    }
+    *after = count->fetch_add(1, std::memory_order_relaxed) + 1;
+    return 0;
+}
+
+// verdict_map is the source of truth, since the controller deletes from it
+// when a ban expires; the cache only keeps an offender's packets from
+// costing a syscall each more than once per tick.
+int hp_flag(capture_policy *p, __u32 src_ip) {
+    uint32_t tick = p->s->tick.load(std::memory_order_relaxed);
+    std::atomic<uint32_t> *seen = p->s->flag_cache.find_or_insert(src_ip);
+    if (seen && seen->exchange(tick, std::memory_order_relaxed) == tick)
+        return 0;
+    __u32 flags = HONEYPOT_VERDICT_SHADOW;
+    return !bpf_map_update_elem(p->s->verdict_fd, &src_ip, &flags, BPF_NOEXIST);
+}
+
+void hp_post(capture_policy *p, __u32 type, __u32 src_ip, __u32 count) {
+    if (type != HONEYPOT_EVENT_THRESHOLD)
+        return;
+    p->stats->flagged.fetch_add(1, std::memory_order_relaxed);
+    if (p->s->bus)
+        p->s->bus->publish(event_bus_record{now_ns(), src_ip, EVENT_BUS_HONEYPOT,
+                                            static_cast<uint16_t>(type), count, 1});
+}
+
+// The SYN-flood guard stays with the kernel program; the capture engine
+// counts every source at the configured threshold.
+int hp_guard(capture_policy *, honeypot_guard_view *) { return 0; }
+
+// ldh [12]; jeq ETH_P_IP; ldb [23]; jeq IPPROTO_TCP; ldxb 4*([14]&0xf);
+// ldh [x+16]; jeq 22: accept kSnapLen bytes, else nothing. The core
+// re-parses what passes, so this only has to be a superset of its match.
+const sock_filter kSshFilter[] = {
+    {0x28, 0, 0, 12},
+    {0x15, 0, 6, ETH_P_IP},
+    {0x30, 0, 0, 23},
+    {0x15, 0, 4, IPPROTO_TCP},
+    {0xb1, 0, 0, 14},
+    {0x48, 0, 0, 16},
+    {0x15, 0, 1, HONEYPOT_SSH_PORT},
+    {0x06, 0, 0, kSnapLen},
+    {0x06, 0, 0, 0},
+};
+
+struct ring {
+    int      fd = -1;
+    char    *map = nullptr;
+    unsigned blocks = 0;
+};
+
+// Socket, filter, V3 ring, bind, fanout; in that order so no unfiltered
+// packet lands in the ring and the group only sees bound members.
+int open_ring(unsigned ifindex, int fanout_id, unsigned blocks, ring &r) {
+    r.blocks = blocks;
+    r.fd = socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC, htons(ETH_P_IP));
+    if (r.fd < 0)
+        return -errno;
+    int version = TPACKET_V3, one = 1;
+    sock_fprog prog{static_cast<unsigned short>(sizeof(kSshFilter) / sizeof(kSshFilter[0])),
+                    const_cast<sock_filter *>(kSshFilter)};
+    tpacket_req3 req{};
+    req.tp_block_size = kBlockSize;
+    req.tp_block_nr = blocks;
+    req.tp_frame_size = kFrameSize;
+    req.tp_frame_nr = kBlockSize / kFrameSize * blocks;
+    req.tp_retire_blk_tov = kBlockTimeoutMs;
+    sockaddr_ll addr{};
+    addr.sll_family = AF_PACKET;
+    addr.sll_protocol = htons(ETH_P_IP);
+    addr.sll_ifindex = static_cast<int>(ifindex);
+    int fanout = fanout_id | (PACKET_FANOUT_HASH << 16);
+
+    if (setsockopt(r.fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) ||
+        setsockopt(r.fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) ||
+        setsockopt(r.fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)))
+        return -errno;
+    // Our own outgoing SSH would otherwise be counted against the local
+    // address; XDP only ever sees ingress. Older kernels lack the option.
+    setsockopt(r.fd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &one, sizeof(one));
+    // The ring is kernel memory and never swapped; MAP_LOCKED would only
+    // charge it to RLIMIT_MEMLOCK.
+    void *map = mmap(nullptr, static_cast<size_t>(kBlockSize) * blocks, PROT_READ | PROT_WRITE,
+                     MAP_SHARED, r.fd, 0);
+    if (map == MAP_FAILED)
+        return -errno;
+    r.map = static_cast<char *>(map);
+    if (bind(r.fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) ||
+        setsockopt(r.fd, SOL_PACKET, PACKET_FANOUT, &fanout, sizeof(fanout)))
+        return -errno;
+    return 0;
+}
+
+void close_ring(ring &r) {
+    if (r.map)
+        munmap(r.map, static_cast<size_t>(kBlockSize) * r.blocks);
+    if (r.fd >= 0)
+        close(r.fd);
+}
+
+void run_worker(const ring &r, capture_state &s, worker_stats &stats, int cpu) {
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+    capture_policy policy{&s, &stats, {}, {}, nullptr};
+    // Fanout by flow hash keeps each connection on one worker, so flows
+    // need no sharing.
+    std::unordered_map<honeypot_flow_key, honeypot_flow, honeypot_flow_key_hash, honeypot_flow_key_eq> flows;
+    pollfd pfd{r.fd, POLLIN | POLLERR, 0};
+    unsigned block = 0;
+    while (!g_stop.load(std::memory_order_relaxed)) {
+        auto *bd = reinterpret_cast<tpacket_block_desc *>(r.map + static_cast<size_t>(block) * kBlockSize);
+        if (!(__atomic_load_n(&bd->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) {
+            poll(&pfd, 1, 100);
+            continue;
+        }
+        policy.refresh();
+        uint32_t n = bd->hdr.bh1.num_pkts;
+        auto *pkt = reinterpret_cast<tpacket3_hdr *>(reinterpret_cast<char *>(bd) +
+                                                     bd->hdr.bh1.offset_to_first_pkt);
+        for (uint32_t i = 0; i < n; i++) {
+            const char *frame = reinterpret_cast<const char *>(pkt) + pkt->tp_mac;
+            const char *end = frame + pkt->tp_snaplen;
+            __u32 src_ip;
+            if (honeypot_parse(frame, end, &src_ip)) {
+                honeypot_syn_fp fp;
+                int attempt = honeypot_syn_fingerprint(frame, end, &fp) ||
+                              honeypot_track_flow(flows, frame, end);
+                honeypot_decide(&policy, src_ip, &policy.ifc, nullptr, attempt);
+            }
+            pkt = reinterpret_cast<tpacket3_hdr *>(reinterpret_cast<char *>(pkt) + pkt->tp_next_offset);
+        }
+        stats.packets.fetch_add(n, std::memory_order_relaxed);
+        __atomic_store_n(&bd->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        block = (block + 1) % r.blocks;
+    }
+}
+
+// Pulls epoch, threshold, the if_config entry of ifindex and the allowlist
+// from the pins. A rotation clears the retired slot, as refresh_slot does
+// for honeypot-ctl rotate; one clear per step, so a jump of several epochs
+// between ticks ends in the same state. An interface without an entry
+// enforces with the global threshold, as in the kernel.
+void sync_pins(capture_state &s, int cfg_fd, int allow_fd, int ifc_fd, __u32 ifindex,
+               uint32_t &seen_epoch) {
+    __u32 zero = 0;
+    honeypot_config cfg{};
+    if (!bpf_map_lookup_elem(cfg_fd, &zero, &cfg)) {
+        // epoch is a slot index that wraps (honeypot-ctl rotate), so
+        // compare slots: each step the slot after the new current one, the
+        // oldest, is emptied, and the previous window is kept.
+        for (unsigned step = 0; seen_epoch % HONEYPOT_EPOCHS != cfg.epoch % HONEYPOT_EPOCHS &&
+                                step < HONEYPOT_EPOCHS; step++) {
+            seen_epoch = (seen_epoch + 1) % HONEYPOT_EPOCHS;
+            s.tables[(seen_epoch + 1) % HONEYPOT_EPOCHS].clear();
+        }
+        seen_epoch = cfg.epoch;
+        s.threshold.store(cfg.threshold, std::memory_order_relaxed);
+        s.epoch.store(cfg.epoch, std::memory_order_relaxed);
+    }
+    honeypot_if_config ifc{HONEYPOT_IF_ENFORCE, 0};
+    if (ifc_fd >= 0 && (!bpf_map_lookup_elem(ifc_fd, &ifindex, &ifc) || errno == ENOENT)) {
+        s.if_mode.store(ifc.mode, std::memory_order_relaxed);
+        s.if_threshold.store(ifc.threshold, std::memory_order_relaxed);
+    }
+    struct entry {
+        uint32_t src_ip, flags;
+    };
+    std::vector<entry> recs;
+    if (allow_fd >= 0 && !honeypot_dump_table(allow_fd, recs)) {
+        auto allow = std::make_shared<address_list>();
+        allow->reserve(recs.size());
+        for (const entry &e : recs)
+            allow->push_back(e.src_ip);
+        std::sort(allow->begin(), allow->end());
+        std::atomic_store(&s.allowlist, std::shared_ptr<const address_list>(std::move(allow)));
+    }
+    s.tick.fetch_add(1, std::memory_order_relaxed);
+}
+
+void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s <ifname> [--threads <n>] [--entries <n>] [--tick-ms <ms>] [--ring-mb <n>]\n"
+            "          [--bus <shm-name>]\n",
+            argv0);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const char *ifname = nullptr, *bus_name = nullptr;
+    unsigned threads = 0, tick_ms = 1000, ring_mb = kRingMb;
+    size_t entries = 1u << 20;
+    for (int i = 1; i < argc; i++) {
+        // Table sizes double to the next power of two, and the tick is
+        // slept in microseconds.
+        unsigned long v;
+        if (!strcmp(argv[i], "--threads") && i + 1 < argc &&
+            honeypot_parse_num(argv[i + 1], 10, 1, 1024, v)) {
+            threads = static_cast<unsigned>(v);
+            i++;
+        } else if (!strcmp(argv[i], "--entries") && i + 1 < argc &&
+                   honeypot_parse_num(argv[i + 1], 10, 1, 1ul << 30, v)) {
+            entries = v;
+            i++;
+        } else if (!strcmp(argv[i], "--tick-ms") && i + 1 < argc &&
+                   honeypot_parse_num(argv[i + 1], 10, 1, 3600000, v)) {
+            tick_ms = static_cast<unsigned>(v);
+            i++;
+        } else if (!strcmp(argv[i], "--ring-mb") && i + 1 < argc &&
+                   honeypot_parse_num(argv[i + 1], 10, 1, 1024, v)) {
+            ring_mb = static_cast<unsigned>(v);
+            i++;
+        } else if (!strcmp(argv[i], "--bus") && i + 1 < argc) {
+            bus_name = argv[++i];
+        } else if (argv[i][0] != '-' && !ifname) {
+            ifname = argv[i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!ifname) {
+        usage(argv[0]);
+        return 2;
+    }
+    unsigned ifindex = if_nametoindex(ifname);
+    if (!ifindex) {
+        fprintf(stderr, "[honeypot-capture] unknown interface %s\n", ifname);
+        return 1;
+    }
+
+    std::vector<int> cpus;
+    cpu_set_t allowed;
+    if (!sched_getaffinity(0, sizeof(allowed), &allowed))
+        for (int c = 0; c < CPU_SETSIZE; c++)
+            if (CPU_ISSET(c, &allowed))
+                cpus.push_back(c);
+    if (!threads)
+        threads = cpus.empty() ? 1 : static_cast<unsigned>(cpus.size());
+
+    auto state = std::make_unique<capture_state>(entries);
+    state->verdict_fd = bpf_obj_get(HONEYPOT_VERDICT_MAP_PIN);
+    int cfg_fd = bpf_obj_get(HONEYPOT_CFG_PIN);
+    int allow_fd = bpf_obj_get(HONEYPOT_ALLOWLIST_PIN);
+    int ifc_fd = bpf_obj_get(HONEYPOT_IF_CONFIG_PIN);
+    if (state->verdict_fd < 0 || cfg_fd < 0) {
+        fprintf(stderr, "[honeypot-capture] %s: %s (run honeypot-loader attach first)\n",
+                state->verdict_fd < 0 ? HONEYPOT_VERDICT_MAP_PIN : HONEYPOT_CFG_PIN, strerror(errno));
+        return 1;
+    }
+    if (allow_fd < 0)
+        fprintf(stderr, "[honeypot-capture] %s: %s, no allowlist\n", HONEYPOT_ALLOWLIST_PIN, strerror(errno));
+    if (ifc_fd < 0)
+        fprintf(stderr, "[honeypot-capture] %s: %s, enforcing on %s\n", HONEYPOT_IF_CONFIG_PIN, strerror(errno),
+                ifname);
+    event_bus bus;
+    if (bus_name) {
+        int err = bus.open(bus_name, 65536);
+        if (err)
+            fprintf(stderr, "[honeypot-capture] bus %s: %s\n", bus_name, strerror(-err));
+        else
+            state->bus = &bus;
+    }
+    uint32_t seen_epoch = 0;
+    __u32 zero = 0;
+    honeypot_config cfg{};
+    if (!bpf_map_lookup_elem(cfg_fd, &zero, &cfg))
+        seen_epoch = cfg.epoch;
+    sync_pins(*state, cfg_fd, allow_fd, ifc_fd, ifindex, seen_epoch);
+
+    // Fanout ids are per network namespace; the pid keeps two instances on
+    // different interfaces from joining each other's group.
+    int fanout_id = getpid() & 0xffff;
+    std::vector<ring> rings(threads);
+    for (ring &r : rings) {
+        int err = open_ring(ifindex, fanout_id, ring_mb * ((1u << 20) / kBlockSize), r);
+        if (err) {
+            fprintf(stderr, "[honeypot-capture] %s: packet ring: %s\n", ifname, strerror(-err));
+            for (ring &c : rings)
+                close_ring(c);
+            return 1;
+        }
+    }
+
+    struct sigaction sa{};
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    std::vector<worker_stats> stats(threads);
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < threads; i++) {
+        int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+        workers.emplace_back(run_worker, std::cref(rings[i]), std::ref(*state), std::ref(stats[i]), cpu);
+    }
+    printf("[honeypot-capture] %s: %u workers, fanout group %d\n", ifname, threads, fanout_id);
+
+    uint64_t kernel_drops = 0;
+    while (!g_stop.load()) {
+        usleep(tick_ms * 1000);
+        sync_pins(*state, cfg_fd, allow_fd, ifc_fd, ifindex, seen_epoch);
+        for (const ring &r : rings) {
+            tpacket_stats_v3 st{};
+            socklen_t len = sizeof(st);
+            if (!getsockopt(r.fd, SOL_PACKET, PACKET_STATISTICS, &st, &len))
+                kernel_drops += st.tp_drops;        // reading resets the counters
+        }
+    }
+
+    for (auto &t : workers)
+        t.join();
+    uint64_t packets = 0, flagged = 0, full = 0;
+    for (const worker_stats &st : stats) {
+        packets += st.packets.load();
+        flagged += st.flagged.load();
+        full += st.table_full.load();
+    }
+    printf("[honeypot-capture] %llu packets (%llu dropped by the kernel), %llu sources flagged, "
+           "%llu uncounted with a full table\n",
+           static_cast<unsigned long long>(packets), static_cast<unsigned long long>(kernel_drops),
+           static_cast<unsigned long long>(flagged), static_cast<unsigned long long>(full));
+    for (ring &r : rings)
+        close_ring(r);
+    close(cfg_fd);
+    if (allow_fd >= 0)
+        close(allow_fd);
+    if (ifc_fd >= 0)
+        close(ifc_fd);
+    close(state->verdict_fd);
+    return 0;
+}
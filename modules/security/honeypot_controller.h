@@ -0,0 +1,127 @@
+// modules/security/honeypot_controller.h — in-process access to the pinned
+// honeypot maps for long-lived callers (the Python extension in
+// honeypot_py.cpp). Opens every pin once, then answers each query with
+// direct bpf() syscalls: no bpftool, no fork, no JSON. Methods return 0 or
+// -errno like the rest of the honeypot tools. Header-only like
+// honeypot_maps.h.
+
+#ifndef OMNICLAW_HONEYPOT_CONTROLLER_H
+#define OMNICLAW_HONEYPOT_CONTROLLER_H
+
+#include <bpf/bpf.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "honeypot.h"
+#include "honeypot_maps.h"
+
+class honeypot_controller {
+public:
+    struct offender {
+        uint32_t src_ip;    // network order
+        uint32_t count;     // attempts in the current window
+    };
+
+    honeypot_controller() = default;
+    ~honeypot_controller() {
+        for (int fd : {holder_, cfg_, allow_, verdict_})
+            if (fd >= 0)
+                close(fd);
+    }
+
+    honeypot_controller(const honeypot_controller &) = delete;
+    honeypot_controller &operator=(const honeypot_controller &) = delete;
+
+    int open() {
+        holder_ = bpf_obj_get(HONEYPOT_ATTACK_MAP_PIN);
+        cfg_ = bpf_obj_get(HONEYPOT_CFG_PIN);
+        allow_ = bpf_obj_get(HONEYPOT_ALLOWLIST_PIN);
+        verdict_ = bpf_obj_get(HONEYPOT_VERDICT_MAP_PIN);
+        return holder_ < 0 || cfg_ < 0 || allow_ < 0 || verdict_ < 0 ? -ENOENT : 0;
+    }
+
+    // Attempts by src in the window the program sees (current epoch plus
+    // the previous one); 0 for an unknown source.
+    int lookup(uint32_t src, uint32_t &count) {
+        int epoch = honeypot_current_epoch(cfg_);
+        if (epoch < 0)
+            return epoch;
+        count = 0;
+        for (__u32 slot : {static_cast<__u32>(epoch), honeypot_prev_epoch(epoch)}) {
+            int fd = honeypot_open_table(holder_, slot);
+            if (fd == -ENOENT)
+                continue;
+            if (fd < 0)
+                return fd;
+            uint32_t v = 0;
+            int err = bpf_map_lookup_elem(fd, &src, &v) && errno != ENOENT ? -errno : 0;
+            close(fd);
+            if (err)
+                return err;
+            count += v;
+        }
+        return 0;
+    }
+
+    // Every source with more than min_count attempts in the window.
+    int dump(uint32_t min_count, std::vector<offender> &out) {
+        std::vector<offender> all;
+        int err = honeypot_dump_window(holder_, cfg_, all);
+        if (err)
+            return err;
+        out.clear();
+        for (const offender &o : all)
+            if (o.count > min_count)
+                out.push_back(o);
+        return 0;
+    }
+
+    // Threshold in force: the configured one, or the compiled-in default.
+    int threshold(uint32_t &value) {
+        honeypot_config conf{};
+        __u32 zero = 0;
+        if (bpf_map_lookup_elem(cfg_, &zero, &conf))
+            return -errno;
+        value = conf.threshold ? conf.threshold : HONEYPOT_DEFAULT_THRESHOLD;
+        return 0;
+    }
+
+    // Takes effect on the next packet; 0 restores the default.
+    int set_threshold(uint32_t value) {
+        return honeypot_cfg_store(cfg_, offsetof(honeypot_config, threshold), value);
+    }
+
+    // Allowlisting also lifts an existing verdict, so sk_lookup stops
+    // steering the source at once.
+    int allow(uint32_t src) {
+        __u32 one = 1;
+        if (bpf_map_update_elem(allow_, &src, &one, BPF_ANY))
+            return -errno;
+        if (bpf_map_delete_elem(verdict_, &src) && errno != ENOENT)
+            return -errno;
+        return 0;
+    }
+
+    int disallow(uint32_t src) {
+        return bpf_map_delete_elem(allow_, &src) && errno != ENOENT ? -errno : 0;
+    }
+
+    int allowed(uint32_t src, bool &yes) {
+        __u32 v;
+        if (!bpf_map_lookup_elem(allow_, &src, &v)) {
+            yes = true;
+            return 0;
+        }
+        yes = false;
+        return errno == ENOENT ? 0 : -errno;
+    }
+
+private:
+    int holder_ = -1, cfg_ = -1, allow_ = -1, verdict_ = -1;
+};
+
+#endif // OMNICLAW_HONEYPOT_CONTROLLER_H
@@ -0,0 +1,776 @@
+// modules/security/honeypot_core.h — detection logic of xdp_ssh_redirect
+// Packet parsing and the count/flag decision, written once and compiled
+// twice: into honeypot.bpf.o and natively into honeypot_sim.cpp, so a
+// replay in userspace reaches the same verdicts as the kernel for the same
+// packets and map contents.
+//
+// The BPF objects are built as C (clang -x c -target bpf, which defines
+// __bpf__), the userspace engines as C++. Every map access goes through a
+// policy, bound at compile time:
+//   - BPF: the includer defines struct honeypot_policy and the hp_*
+//     functions below as static inlines over its maps before including
+//     this header;
+//   - native: honeypot_decide() and its halves, honeypot_screen() and
+//     honeypot_count(), are templates over the policy type and find the
+//     policy's hp_* overloads by argument-dependent lookup.
+// Either way the calls inline away; nothing is dispatched at run time.
+//
+// Policy interface (src_ip in network order):
+//   int   hp_allowed(P *, __u32 src)                   allowlisted?
+//   int   hp_intel_blocked(P *, __u32 src)             on a threat-intel feed?
+//   const struct honeypot_config *hp_config(P *)       nullptr when unset
+//   __u32 hp_peek_count(P *, __u32 slot, __u32 src)    0 when absent
+//   int   hp_bump_count(P *, __u32 slot, __u32 src, __u32 *after)
+//                                                      +1 or insert 1; -1 without a table
+//   int   hp_flag(P *, __u32 src)                      1 if newly flagged
+//   void  hp_post(P *, __u32 type, __u32 src, __u32 count)
+//   int   hp_guard(P *, struct honeypot_guard_view *)  0 when the flood guard is off
+//
+// The parsers (honeypot_syn_fingerprint(), honeypot_parse_segment(),
+// honeypot_ssh_banner(), honeypot_kex_feed()) and the flow steps
+// (honeypot_flow_open(), honeypot_flow_segment()) need no policy; the
+// includer keeps the flows.
+//
+// The includer also provides IPPROTO_TCP, bpf_ntohs(), bpf_ntohl() and bpf_htons()
+// (linux/in.h or netinet/in.h, and bpf/bpf_endian.h), and in BPF bpf_loop()
+// (bpf/bpf_helpers.h).
+
+#ifndef OMNICLAW_HONEYPOT_CORE_H
+#define OMNICLAW_HONEYPOT_CORE_H
+
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/ip.h>
+#include <linux/tcp.h>
+
+#include "honeypot.h"
+
+#ifndef __bpf__
+#include <cstddef>
+#endif
+
+#ifndef __always_inline
+#define __always_inline inline __attribute__((always_inline))
+#endif
+
+#ifndef __bpf__
+#define HONEYPOT_POLICY_FN(ret) template <typename Policy> static __always_inline ret
+#define HONEYPOT_POLICY Policy *policy
+#else
+#define HONEYPOT_POLICY_FN(ret) static __always_inline ret
+#define HONEYPOT_POLICY struct honeypot_policy *policy
+#endif
+
+// Bytes honeypot_parse() may read: Ethernet, the longest IPv4 header and
+// a TCP header. A TC program pulls this much into the linear area first.
+#define HONEYPOT_PARSE_BYTES (sizeof(struct ethhdr) + 60 + sizeof(struct tcphdr))
+
+// Source address of an IPv4 TCP segment to HONEYPOT_SSH_PORT; 0 for any
+// other frame.
+static __always_inline int honeypot_parse(const void *data, const void *data_end, __u32 *src_ip) {
+    const char *end = (const char *)data_end;
+
+    const struct ethhdr *eth = (const struct ethhdr *)data;
+    if ((const char *)(eth + 1) > end)
+        return 0;
+    if (bpf_ntohs(eth->h_proto) != ETH_P_IP)
+        return 0;
+
+    const struct iphdr *ip = (const struct iphdr *)(eth + 1);
+    if ((const char *)(ip + 1) > end)
+        return 0;
+    if (ip->protocol != IPPROTO_TCP)
+        return 0;
+
+    const struct tcphdr *tcp = (const struct tcphdr *)((const char *)ip + ip->ihl * 4);
+    if ((const char *)(tcp + 1) > end)
+        return 0;
+    if (bpf_ntohs(tcp->dest) != HONEYPOT_SSH_PORT)
+        return 0;
+
+    *src_ip = ip->saddr;
+    return 1;
+}
+
+// A TCP probe to any port: an IPv4 segment without ACK or RST, which is
+// what SYN, FIN, NULL and Xmas scans send and what no established
+// connection does. Feeds the port-scan stage, before the SSH filter.
+static __always_inline int honeypot_parse_probe(const void *data, const void *data_end,
+                                                __u32 *src_ip, __u32 *dst_ip, __u16 *dport) {
+    const char *end = (const char *)data_end;
+    const struct ethhdr *eth = (const struct ethhdr *)data;
+    if ((const char *)(eth + 1) > end || bpf_ntohs(eth->h_proto) != ETH_P_IP)
+        return 0;
+    const struct iphdr *ip = (const struct iphdr *)(eth + 1);
+    if ((const char *)(ip + 1) > end || ip->protocol != IPPROTO_TCP)
+        return 0;
+    const struct tcphdr *tcp = (const struct tcphdr *)((const char *)ip + ip->ihl * 4);
+    if ((const char *)(tcp + 1) > end || tcp->ack || tcp->rst)
+        return 0;
+
+    *src_ip = ip->saddr;
+    *dst_ip = ip->daddr;
+    *dport = bpf_ntohs(tcp->dest);
+    return 1;
+}
+
+// Option list steps a fingerprint walks: 40 bytes of options hold at most
+// a handful of real ones, but a stack may pad with NOPs.
+#define HONEYPOT_FP_OPT_STEPS 16
+
+// Reads the TCP option at byte *at of the opts_len option bytes into fp,
+// its kind into byte fp->nopts of *kinds, and moves *at past it; 1 once
+// the list ends or cannot be read on. Reads go by offset, bounded by the
+// 40 bytes options can take, and are checked against data_end.
+static __always_inline int honeypot_fp_opt(const __u8 *opts, const void *data_end, __u32 *at,
+                                           __u32 opts_len, struct honeypot_syn_fp *fp, __u64 *kinds) {
+    const __u8 *end = (const __u8 *)data_end;
+    if (*at >= opts_len || *at >= 40)
+        return 1;
+    const __u8 *opt = opts + *at;
+    if (opt + 1 > end)
+        return 1;
+    __u8 kind = opt[0];
+    if (kind == 0)                      // end of options
+        return 1;
+    if (fp->nopts < HONEYPOT_FP_MAX_OPTS)
+        *kinds |= (__u64)kind << (8 * fp->nopts++);
+    if (kind == 1) {                    // NOP
+        *at += 1;
+        return 0;
+    }
+    if (opt + 2 > end || opt[1] < 2)
+        return 1;
+    __u8 len = opt[1];
+    if (kind == 2 && len == 4 && opt + 4 <= end)
+        fp->mss = (__u16)(opt[2] << 8 | opt[3]);
+    else if (kind == 3 && len == 3 && opt + 3 <= end)
+        fp->wscale = opt[2];
+    *at += len;
+    return 0;
+}
+
+// Walks up to HONEYPOT_FP_OPT_STEPS options into fp. In BPF each option
+// is one bpf_loop() step: unrolled, every mix of NOPs and lengths before
+// an option was a separate verifier state. The kinds are packed into a
+// word on the way and stored at the end, so no step writes fp->opts at a
+// variable index.
+static __always_inline void honeypot_fp_kinds(struct honeypot_syn_fp *fp, __u64 kinds) {
+    for (int i = 0; i < HONEYPOT_FP_MAX_OPTS; i++)
+        fp->opts[i] = (__u8)(kinds >> (8 * i));
+}
+
+#ifndef __bpf__
+static inline void honeypot_fp_opts(const __u8 *opts, const void *data_end, __u32 opts_len,
+                                    struct honeypot_syn_fp *fp) {
+    __u32 at = 0;
+    __u64 kinds = 0;
+    for (int i = 0; i < HONEYPOT_FP_OPT_STEPS; i++) {
+        if (honeypot_fp_opt(opts, data_end, &at, opts_len, fp, &kinds))
+            break;
+    }
+    honeypot_fp_kinds(fp, kinds);
+}
+#else
+struct honeypot_fp_opts_ctx {
+    const __u8 *opts;
+    const void *end;
+    __u32 at;
+    __u32 opts_len;
+    __u64 kinds;
+    struct honeypot_syn_fp fp;
+};
+
+static long honeypot_fp_opt_step(__u64 i, void *arg) {
+    struct honeypot_fp_opts_ctx *c = (struct honeypot_fp_opts_ctx *)arg;
+    return honeypot_fp_opt(c->opts, c->end, &c->at, c->opts_len, &c->fp, &c->kinds);
+}
+
+static __always_inline void honeypot_fp_opts(const __u8 *opts, const void *data_end, __u32 opts_len,
+                                             struct honeypot_syn_fp *fp) {
+    struct honeypot_fp_opts_ctx c = {
+        .opts = opts, .end = data_end, .opts_len = opts_len, .fp = *fp,
+    };
+    bpf_loop(HONEYPOT_FP_OPT_STEPS, honeypot_fp_opt_step, &c, 0);
+    *fp = c.fp;
+    honeypot_fp_kinds(fp, c.kinds);
+}
+#endif
+
+// Fingerprint of an IPv4 TCP SYN (without ACK); 0 for any other frame.
+// Options are walked in a bounded loop, every read checked against both
+// the TCP header length and data_end.
+static __always_inline int honeypot_syn_fingerprint(const void *data, const void *data_end,
+                                                    struct honeypot_syn_fp *fp) {
+    const char *end = (const char *)data_end;
+    const struct ethhdr *eth = (const struct ethhdr *)data;
+    if ((const char *)(eth + 1) > end || bpf_ntohs(eth->h_proto) != ETH_P_IP)
+        return 0;
+    const struct iphdr *ip = (const struct iphdr *)(eth + 1);
+    if ((const char *)(ip + 1) > end || ip->protocol != IPPROTO_TCP)
+        return 0;
+    const struct tcphdr *tcp = (const struct tcphdr *)((const char *)ip + ip->ihl * 4);
+    if ((const char *)(tcp + 1) > end || !tcp->syn || tcp->ack)
+        return 0;
+
+    fp->window = bpf_ntohs(tcp->window);
+    fp->mss = 0;
+    fp->ttl = ip->ttl <= 32 ? 32 : ip->ttl <= 64 ? 64 : ip->ttl <= 128 ? 128 : 255;
+    fp->wscale = 0xff;
+    fp->df = !!(ip->frag_off & bpf_htons(0x4000));
+    fp->nopts = 0;
+
+    __u32 opts_len = tcp->doff > 5 ? tcp->doff * 4 - sizeof(*tcp) : 0;
+    honeypot_fp_opts((const __u8 *)(tcp + 1), data_end, opts_len, fp);
+    return 1;
+}
+
+// Fingerprint id: FNV-1a over the whole struct, unused opts zeroed.
+static __always_inline __u32 honeypot_fp_id(const struct honeypot_syn_fp *fp) {
+    const __u8 *b = (const __u8 *)fp;
+    __u32 h = 2166136261u;
+    for (unsigned i = 0; i < sizeof(*fp); i++)
+        h = (h ^ b[i]) * 16777619u;
+    return h;
+}
+
+// 4-tuple and payload of an IPv4 TCP segment to HONEYPOT_SSH_PORT; 0 for
+// any other frame. *payload_off counts from data, *payload_len comes from
+// the IP total length and may reach past data_end when the frame is not
+// linear. *seq is the sequence number of the first payload byte (host
+// order); *fin is set for FIN and RST.
+static __always_inline int honeypot_parse_segment(const void *data, const void *data_end,
+                                                  struct honeypot_flow_key *key, __u32 *payload_off,
+                                                  __u32 *payload_len, __u32 *seq, int *fin) {
+    const char *end = (const char *)data_end;
+    const struct ethhdr *eth = (const struct ethhdr *)data;
+    if ((const char *)(eth + 1) > end || bpf_ntohs(eth->h_proto) != ETH_P_IP)
+        return 0;
+    const struct iphdr *ip = (const struct iphdr *)(eth + 1);
+    if ((const char *)(ip + 1) > end || ip->protocol != IPPROTO_TCP)
+        return 0;
+    const struct tcphdr *tcp = (const struct tcphdr *)((const char *)ip + ip->ihl * 4);
+    if ((const char *)(tcp + 1) > end || bpf_ntohs(tcp->dest) != HONEYPOT_SSH_PORT)
+        return 0;
+
+    key->saddr = ip->saddr;
+    key->daddr = ip->daddr;
+    key->sport = tcp->source;
+    key->dport = tcp->dest;
+    __u32 headers = ip->ihl * 4 + tcp->doff * 4;
+    __u32 total = bpf_ntohs(ip->tot_len);
+    *payload_off = sizeof(*eth) + headers;
+    *payload_len = total > headers ? total - headers : 0;
+    *seq = bpf_ntohl(tcp->seq);
+    *fin = tcp->fin || tcp->rst;
+    return 1;
+}
+
+// Longest identification line (RFC 4253 4.2), and the payload offsets the
+// KEXINIT scan reaches (a power of two). Name lists longer than
+// HONEYPOT_KEX_LIST_MAX make a KEXINIT unreadable.
+#define HONEYPOT_BANNER_MAX   255
+#define HONEYPOT_KEX_SPAN     2048
+#define HONEYPOT_KEX_LIST_MAX 1024
+
+// honeypot_kex_feed() results.
+#define HONEYPOT_KEX_MORE   0       // continues in a later segment
+#define HONEYPOT_KEX_DONE   1       // ks->hash is the fingerprint
+#define HONEYPOT_KEX_BAD   (-1)     // not a KEXINIT this scan can read
+#define HONEYPOT_KEX_SHORT (-2)     // payload not linear; ks is undefined
+
+// Offset just past the "\n" that ends an identification line whose
+// first four bytes ("SSH-") were checked; 0 if there is none within
+// HONEYPOT_BANNER_MAX bytes, HONEYPOT_KEX_SHORT if the payload is not
+// linear that far. In BPF the scan goes through bpf_loop(): unrolled, the
+// verifier would carry each line length it could end at into the KEXINIT
+// scan as a separate constant offset.
+#ifndef __bpf__
+static inline int honeypot_banner_end(const __u8 *payload, const void *data_end, __u32 len) {
+    const __u8 *end = (const __u8 *)data_end;
+    for (__u32 i = 4; i < HONEYPOT_BANNER_MAX; i++) {
+        if (i >= len)
+            return 0;
+        const __u8 *p = payload + (i & 0xff);
+        if (p + 1 > end)
+            return HONEYPOT_KEX_SHORT;
+        if (*p == '\n')
+            return (int)i + 1;
+    }
+    return 0;
+}
+#else
+struct honeypot_banner_ctx {
+    const __u8 *payload;
+    const __u8 *end;
+    __u32 len;
+    int result;
+};
+
+static long honeypot_banner_byte(__u64 i, void *arg) {
+    struct honeypot_banner_ctx *c = (struct honeypot_banner_ctx *)arg;
+    __u32 at = (__u32)i + 4;
+    if (at >= c->len)
+        return 1;
+    const __u8 *p = c->payload + (at & 0xff);
+    if (p + 1 > c->end) {
+        c->result = HONEYPOT_KEX_SHORT;
+        return 1;
+    }
+    if (*p != '\n')
+        return 0;
+    c->result = (int)(at & 0xff) + 1;
+    return 1;
+}
+
+static __always_inline int honeypot_banner_end(const __u8 *payload, const void *data_end, __u32 len) {
+    struct honeypot_banner_ctx c = {
+        .payload = payload, .end = (const __u8 *)data_end, .len = len,
+    };
+    bpf_loop(HONEYPOT_BANNER_MAX - 4, honeypot_banner_byte, &c, 0);
+    return c.result;
+}
+#endif
+
+// Offset just past the identification line ("SSH-...\r\n") that opens a
+// client payload; 0 if the payload does not start with one,
+// HONEYPOT_KEX_SHORT if it is not linear that far.
+static __always_inline int honeypot_ssh_banner(const __u8 *payload, const void *data_end, __u32 len) {
+    const __u8 *end = (const __u8 *)data_end;
+    if (len < 4)
+        return 0;
+    if (payload + 4 > end)
+        return HONEYPOT_KEX_SHORT;
+    if (payload[0] != 'S' || payload[1] != 'S' || payload[2] != 'H' || payload[3] != '-')
+        return 0;
+    return honeypot_banner_end(payload, data_end, len);
+}
+
+// Feeds one byte to the KEXINIT scan in ks. A name list's length is read
+// a byte at a time into *n, *got counting them; the lists themselves are
+// hashed (FNV-1a) or skipped: 0 (kex), 2 (enc c2s), 4 (mac c2s) and
+// 6 (comp c2s), the odd stages, are hashed, 1, 3 and 5 are not.
+// HONEYPOT_KEX_NEXT while the scan wants more, else a honeypot_kex_feed()
+// result.
+#define HONEYPOT_KEX_NEXT   2
+
+static __always_inline int honeypot_kex_byte(struct honeypot_kex_scan *ks, __u8 b, __u32 *n,
+                                             __u32 *got) {
+    if (!ks->left) {
+        *n = *n << 8 | b;
+        if (++*got < 4)
+            return HONEYPOT_KEX_NEXT;
+        if (!*n || *n > HONEYPOT_KEX_LIST_MAX)
+            return HONEYPOT_KEX_BAD;
+        ks->left = (__u16)*n;
+        *n = 0;
+        *got = 0;
+        if (ks->stage > 1 && (ks->stage & 1))
+            ks->hash = (ks->hash ^ ';') * 16777619u;
+        return HONEYPOT_KEX_NEXT;
+    }
+    if (ks->stage & 1)
+        ks->hash = (ks->hash ^ b) * 16777619u;
+    if (--ks->left)
+        return HONEYPOT_KEX_NEXT;
+    return ++ks->stage > 7 ? HONEYPOT_KEX_DONE : HONEYPOT_KEX_NEXT;
+}
+
+// Feeds payload bytes [off, len) to the scan past the packet header. A
+// list length split over segments is not followed. In BPF the bytes go
+// through bpf_loop() (Linux 5.17), the offset coming from the loop index,
+// so the verifier checks honeypot_kex_byte() once rather than walking it
+// for every byte of the segment at every call site.
+#ifndef __bpf__
+static inline int honeypot_kex_bytes(const __u8 *payload, const void *data_end, __u32 off, __u32 len,
+                                     struct honeypot_kex_scan *ks) {
+    const __u8 *end = (const __u8 *)data_end;
+    __u32 n = 0, got = 0;
+    for (__u32 i = off; i < len; i++) {
+        const __u8 *p = payload + i;
+        if (p + 1 > end)
+            return HONEYPOT_KEX_SHORT;
+        int r = honeypot_kex_byte(ks, *p, &n, &got);
+        if (r != HONEYPOT_KEX_NEXT)
+            return r;
+    }
+    return got ? HONEYPOT_KEX_BAD : HONEYPOT_KEX_MORE;
+}
+#else
+struct honeypot_kex_bytes_ctx {
+    const __u8 *payload;
+    const __u8 *end;
+    __u32 off;
+    __u32 n;
+    __u32 got;
+    struct honeypot_kex_scan ks;
+    int result;
+};
+
+static long honeypot_kex_next(__u64 i, void *arg) {
+    struct honeypot_kex_bytes_ctx *c = (struct honeypot_kex_bytes_ctx *)arg;
+    const __u8 *p = c->payload + ((c->off + (__u32)i) & (HONEYPOT_KEX_SPAN - 1));
+    if (p + 1 > c->end) {
+        c->result = HONEYPOT_KEX_SHORT;
+        return 1;
+    }
+    c->result = honeypot_kex_byte(&c->ks, *p, &c->n, &c->got);
+    return c->result != HONEYPOT_KEX_NEXT;
+}
+
+static __always_inline int honeypot_kex_bytes(const __u8 *payload, const void *data_end, __u32 off,
+                                              __u32 len, struct honeypot_kex_scan *ks) {
+    struct honeypot_kex_bytes_ctx c = {
+        .payload = payload, .end = (const __u8 *)data_end, .off = off, .ks = *ks,
+        .result = HONEYPOT_KEX_NEXT,
+    };
+    bpf_loop(len - off, honeypot_kex_next, &c, 0);
+    if (c.result == HONEYPOT_KEX_SHORT)
+        return c.result;
+    *ks = c.ks;
+    if (c.result == HONEYPOT_KEX_NEXT)
+        return c.got ? HONEYPOT_KEX_BAD : HONEYPOT_KEX_MORE;
+    return c.result;
+}
+#endif
+
+// Feeds payload bytes [off, len) of one segment to the KEXINIT scan in ks.
+// Reads are bounded by HONEYPOT_KEX_SPAN and checked against data_end.
+static __always_inline int honeypot_kex_feed(const __u8 *payload, const void *data_end, __u32 off,
+                                             __u32 len, struct honeypot_kex_scan *ks) {
+    const __u8 *end = (const __u8 *)data_end;
+    if (len > HONEYPOT_KEX_SPAN || off > len)
+        return HONEYPOT_KEX_BAD;
+    if (ks->stage == 0) {
+        // uint32 packet_length, byte padding_length, byte SSH_MSG_KEXINIT,
+        // byte[16] cookie; a header split over segments is not followed.
+        if (off == len)
+            return HONEYPOT_KEX_MORE;
+        if (off + 22 > len)
+            return HONEYPOT_KEX_BAD;
+        const __u8 *p = payload + (off & (HONEYPOT_KEX_SPAN - 1));
+        if (p + 22 > end)
+            return HONEYPOT_KEX_SHORT;
+        if (p[5] != 20)
+            return HONEYPOT_KEX_BAD;
+        off += 22;
+        ks->stage = 1;
+        ks->left = 0;
+        ks->hash = 2166136261u;
+    }
+    return honeypot_kex_bytes(payload, data_end, off, len, ks);
+}
+
+// Authentication attempts inside one connection, estimated from the sizes
+// of the client's segments after its KEXINIT (only that direction reaches
+// the ingress hooks). Encrypted sizes round to the cipher block, so the
+// bands are wide:
+//   - the first HONEYPOT_AUTH_SKIP segments finish the key exchange
+//     (ECDH init, NEWKEYS, the service request);
+//   - a segment of HONEYPOT_AUTH_MIN..HONEYPOT_AUTH_MAX bytes is a
+//     USERAUTH_REQUEST, password or public key; a client failing to log in
+//     sends nothing else, the server's failures going the other way;
+//   - a smaller one after the first request is a channel open or a
+//     keystroke: authentication succeeded, and the flow stops counting.
+// The first HONEYPOT_AUTH_FREE requests (the "none" method probe and the
+// first real try) are paid for by the connection's SYN.
+#define HONEYPOT_AUTH_SKIP     2
+#define HONEYPOT_AUTH_MIN      64
+#define HONEYPOT_AUTH_MAX      1024
+#define HONEYPOT_AUTH_FREE     2
+#define HONEYPOT_AUTH_SEGMENTS 64       // past this, a flow is no longer estimated
+
+// Feeds one client segment of payload_len bytes to the estimate of a flow
+// past its KEXINIT. 1 when the segment is a further attempt to count.
+static __always_inline int honeypot_auth_step(struct honeypot_flow *flow, __u32 payload_len) {
+    if (flow->state != HONEYPOT_FLOW_KEXED && flow->state != HONEYPOT_FLOW_OPAQUE)
+        return 0;
+    if (++flow->segments <= HONEYPOT_AUTH_SKIP)
+        return 0;
+    if (flow->segments > HONEYPOT_AUTH_SEGMENTS) {
+        flow->state = HONEYPOT_FLOW_SESSION;
+        return 0;
+    }
+    if (payload_len < HONEYPOT_AUTH_MIN) {
+        if (flow->requests)
+            flow->state = HONEYPOT_FLOW_SESSION;
+        return 0;
+    }
+    if (payload_len > HONEYPOT_AUTH_MAX)
+        return 0;
+    return ++flow->requests > HONEYPOT_AUTH_FREE;
+}
+
+// Opens a flow on a client segment that starts with the identification
+// line, reading whatever of the KEXINIT follows it. 1 when *flow is a new
+// flow, 0 when the segment does not open one, HONEYPOT_KEX_SHORT when the
+// payload is not linear that far. *kexed is set when the client
+// fingerprint (flow->hassh) is already complete.
+static __always_inline int honeypot_flow_open(struct honeypot_flow *flow, const __u8 *payload,
+                                              const void *data_end, __u32 len, __u32 seq, int *kexed) {
+    *kexed = 0;
+    int kex_off = honeypot_ssh_banner(payload, data_end, len);
+    if (kex_off <= 0)
+        return kex_off;
+    struct honeypot_kex_scan ks = {};
+    int r = honeypot_kex_feed(payload, data_end, (__u32)kex_off, len, &ks);
+    if (r == HONEYPOT_KEX_SHORT)
+        return r;
+    flow->state = HONEYPOT_FLOW_KEXINIT;
+    flow->hassh = 0;
+    flow->policy = 0;
+    flow->next_seq = seq + len;
+    flow->segments = 0;
+    flow->requests = 0;
+    flow->pad = 0;
+    flow->kex = ks;
+    if (r == HONEYPOT_KEX_BAD) {
+        flow->state = HONEYPOT_FLOW_OPAQUE;
+    } else if (r == HONEYPOT_KEX_DONE) {
+        flow->state = HONEYPOT_FLOW_KEXED;
+        flow->hassh = ks.hash;
+        *kexed = 1;
+    }
+    return 1;
+}
+
+// Advances an open flow by one client segment of len payload bytes from
+// sequence number seq: the KEXINIT scan until it completes, the attempt
+// estimate after. 1 when the segment is a further attempt to count,
+// HONEYPOT_KEX_SHORT (flow untouched) when the payload is not linear, else
+// 0. *kexed as above.
+static __always_inline int honeypot_flow_segment(struct honeypot_flow *flow, const __u8 *payload,
+                                                 const void *data_end, __u32 len, __u32 seq, int *kexed) {
+    *kexed = 0;
+    if (!len)
+        return 0;
+    // Bytes before next_seq were seen already, bytes after it leave a gap.
+    // A retransmission is neither scanned nor counted again; the estimate
+    // sizes a partly resent segment by its new bytes.
+    __s32 ahead = (__s32)(seq - flow->next_seq);
+    __u32 seen = ahead < 0 ? (__u32)-ahead : 0;
+    if (seen >= len)
+        return 0;
+    if (flow->state != HONEYPOT_FLOW_KEXINIT) {
+        flow->next_seq = seq + len;
+        return honeypot_auth_step(flow, len - seen);
+    }
+    // The scan reads the stream in order: a gap (loss or reordering)
+    // leaves the KEXINIT unreadable.
+    if (ahead > 0) {
+        flow->next_seq = seq + len;
+        flow->state = HONEYPOT_FLOW_OPAQUE;
+        return 0;
+    }
+    struct honeypot_kex_scan ks = flow->kex;
+    int r = honeypot_kex_feed(payload, data_end, seen, len, &ks);
+    if (r == HONEYPOT_KEX_SHORT)
+        return r;
+    flow->next_seq = seq + len;
+    flow->kex = ks;
+    if (r == HONEYPOT_KEX_BAD) {
+        flow->state = HONEYPOT_FLOW_OPAQUE;
+    } else if (r == HONEYPOT_KEX_DONE) {
+        flow->state = HONEYPOT_FLOW_KEXED;
+        flow->hassh = ks.hash;
+        *kexed = 1;
+    }
+    return 0;
+}
+
+// Folds the SYNs of one tick (elapsed_ns long) into the rate. After a quiet
+// spell of HONEYPOT_GUARD_STALE ticks or more the old rate says nothing
+// and the new sample replaces it.
+static __always_inline __u64 honeypot_guard_ewma(__u64 rate, __u64 syns, __u64 elapsed_ns) {
+    __u64 sample = (syns << HONEYPOT_GUARD_SHIFT) * 1000000000ull / elapsed_ns;
+    if (elapsed_ns >= HONEYPOT_GUARD_STALE * HONEYPOT_GUARD_TICK_NS)
+        return sample;
+    if (sample >= rate)
+        return rate + ((sample - rate) >> HONEYPOT_GUARD_EWMA);
+    return rate - ((rate - sample) >> HONEYPOT_GUARD_EWMA);
+}
+
+// The per-source threshold at the guard's rate: unchanged up to the
+// baseline, then scaled by baseline/rate, never below the floor nor above
+// the configured value.
+static __always_inline __u32 honeypot_guard_threshold(__u32 threshold,
+                                                      const struct honeypot_guard_view *g) {
+    __u64 base = (__u64)g->baseline << HONEYPOT_GUARD_SHIFT;
+    if (g->rate <= base)
+        return threshold;
+    __u64 t = (__u64)threshold * base / g->rate;
+    if (t < g->floor)
+        t = g->floor;
+    return t < threshold ? (__u32)t : threshold;
+}
+
+// Whether a source without a counter gets one: always up to the baseline,
+// then with probability baseline/rate.
+static __always_inline int honeypot_guard_admit(const struct honeypot_guard_view *g) {
+    __u64 base = (__u64)g->baseline << HONEYPOT_GUARD_SHIFT;
+    return g->rate <= base || (((__u64)(g->rnd & 0xffff) * g->rate) >> 16) < base;
+}
+
+// honeypot_screen() result: the packet goes on to honeypot_count().
+#define HONEYPOT_SCREENED (-1)
+
+// First half of honeypot_decide(): settles the sources that are never
+// counted (bypass, allowlist, threat intel). Returns their XDP action, or
+// HONEYPOT_SCREENED. Needs nothing from the flow, so a caller that learns
+// only later whether a segment is an attempt screens first and counts
+// then.
+HONEYPOT_POLICY_FN(int) honeypot_screen(HONEYPOT_POLICY, __u32 src_ip,
+                                        const struct honeypot_if_config *ifc,
+                                        struct honeypot_meta *meta) {
+    if (meta) {
+        meta->magic = HONEYPOT_META_MAGIC;
+        meta->src_ip = src_ip;
+        meta->verdict = 0;
+        meta->score = 0;
+        meta->flags = 0;
+    }
+    __u32 mode = ifc ? ifc->mode : HONEYPOT_IF_ENFORCE;
+    if (mode == HONEYPOT_IF_BYPASS || hp_allowed(policy, src_ip)) {
+        if (meta)
+            meta->flags |= HONEYPOT_META_ALLOWED;
+        return XDP_PASS;
+    }
+
+    // Sources listed by a threat-intel feed never get threshold tries.
+    if (hp_intel_blocked(policy, src_ip)) {
+        if (meta)
+            meta->flags |= HONEYPOT_META_INTEL;
+        if (mode == HONEYPOT_IF_MONITOR)
+            return XDP_PASS;
+        hp_post(policy, HONEYPOT_EVENT_INTEL_DROP, src_ip, 0);
+        return XDP_DROP;
+    }
+    return HONEYPOT_SCREENED;
+}
+
+// Second half: counts a screened packet if it is an attempt, else reads
+// the count, and flags the source past the threshold. Returns XDP_PASS.
+HONEYPOT_POLICY_FN(int) honeypot_count(HONEYPOT_POLICY, __u32 src_ip,
+                                       const struct honeypot_if_config *ifc,
+                                       struct honeypot_meta *meta, int attempt) {
+    __u32 mode = ifc ? ifc->mode : HONEYPOT_IF_ENFORCE;
+    const struct honeypot_config *cfg = hp_config(policy);
+    __u32 epoch = cfg ? cfg->epoch % HONEYPOT_EPOCHS : 0;
+    __u32 prev_epoch = (epoch + HONEYPOT_EPOCHS - 1) % HONEYPOT_EPOCHS;
+    __u32 threshold = cfg && cfg->threshold ? cfg->threshold : HONEYPOT_DEFAULT_THRESHOLD;
+    if (ifc && ifc->threshold)
+        threshold = ifc->threshold;
+    struct honeypot_guard_view guard = {};
+    if (hp_guard(policy, &guard))
+        threshold = honeypot_guard_threshold(threshold, &guard);
+
+    // Attempts carried over from the previous epoch, so the estimate
+    // slides instead of dropping to zero at every rotation.
+    __u32 carried = hp_peek_count(policy, prev_epoch, src_ip);
+
+    __u32 count = 0;
+    if (!attempt) {
+        count = hp_peek_count(policy, epoch, src_ip);
+    } else if (!carried && !honeypot_guard_admit(&guard) &&
+               !hp_peek_count(policy, epoch, src_ip)) {
+        // Flood: a source new to the tables gets a counter only by lot,
+        // which keeps the churn of attack_map down. Sources already
+        // counted are unaffected, and one that keeps trying gets in.
+        if (guard.not_admitted)
+            (*guard.not_admitted)++;
+        return XDP_PASS;
+    } else if (hp_bump_count(policy, epoch, src_ip, &count)) {
+        return XDP_PASS;
+    }
+    __u32 total = carried + count;
+    if (meta)
+        meta->score = total;
+
+    if (total > threshold && mode == HONEYPOT_IF_ENFORCE) {
+        // Packet is from a repeat offender. XDP cannot redirect it to a
+        // local socket itself, so it only flags the source and lets the
+        // packet pass; sk_lookup_shadow steers the connection. Hosts
+        // without sk_lookup fall back to netfilter (honeypot.nft).
+        if (attempt && hp_flag(policy, src_ip))
+            hp_post(policy, HONEYPOT_EVENT_THRESHOLD, src_ip, total);
+        if (meta)
+            meta->verdict = HONEYPOT_VERDICT_SHADOW;
+    }
+    return XDP_PASS;
+}
+
+// Handles one SSH packet from src_ip and returns the XDP action for it.
+// attempt says whether the packet counts against the source: a SYN, or a
+// segment honeypot_auth_step() estimated to be a further attempt. Other
+// packets only read the count. ifc is the configuration of the ingress
+// interface, NULL for defaults; meta, when not NULL, receives the outcome
+// for later hooks. During a SYN flood (hp_guard()) the threshold is
+// tightened and new sources are counted only by lot.
+HONEYPOT_POLICY_FN(int) honeypot_decide(HONEYPOT_POLICY, __u32 src_ip,
+                                        const struct honeypot_if_config *ifc,
+                                        struct honeypot_meta *meta, int attempt) {
+    int action = honeypot_screen(policy, src_ip, ifc, meta);
+    return action != HONEYPOT_SCREENED ? action : honeypot_count(policy, src_ip, ifc, meta, attempt);
+}
+
+#ifndef __bpf__
+// Native flow tables for the userspace engines: Flows maps
+// honeypot_flow_key to honeypot_flow, e.g. an unordered_map with these.
+struct honeypot_flow_key_hash {
+    size_t operator()(const honeypot_flow_key &k) const {
+        __u64 h = ((__u64)k.saddr << 32 | k.daddr) * 0x9e3779b97f4a7c15ull;
+        return (size_t)(h ^ ((__u64)k.sport << 16 | k.dport));
+    }
+};
+
+struct honeypot_flow_key_eq {
+    bool operator()(const honeypot_flow_key &a, const honeypot_flow_key &b) const {
+        return a.saddr == b.saddr && a.daddr == b.daddr && a.sport == b.sport && a.dport == b.dport;
+    }
+};
+
+// The flow following of inspect_flow() in honeypot.cpp, without the
+// client-fingerprint counters and policy: 1 when the segment is a further
+// authentication attempt. Payload cut off by a snapshot length only costs
+// the fingerprint (the flow turns opaque); the estimate reads sizes from
+// the IP header. A full table is emptied rather than evicted from.
+template <typename Flows>
+static inline int honeypot_track_flow(Flows &flows, const void *data, const void *data_end) {
+    struct honeypot_flow_key key;
+    __u32 off, len, seq;
+    int fin, kexed;
+    if (!honeypot_parse_segment(data, data_end, &key, &off, &len, &seq, &fin))
+        return 0;
+    auto it = flows.find(key);
+    if (fin) {
+        if (it != flows.end())
+            flows.erase(it);
+        return 0;
+    }
+    const char *end = (const char *)data_end;
+    const __u8 *payload = (const __u8 *)data + off;
+    __u32 captured = (const char *)data + off < end ? (__u32)(end - ((const char *)data + off)) : 0;
+
+    if (it == flows.end()) {
+        struct honeypot_flow flow = {};
+        if (honeypot_flow_open(&flow, payload, data_end, len < captured ? len : captured, seq, &kexed) <= 0)
+            return 0;
+        flow.next_seq = seq + len;
+        if (len > captured && flow.state == HONEYPOT_FLOW_KEXINIT)
+            flow.state = HONEYPOT_FLOW_OPAQUE;
+        if (flows.size() >= HONEYPOT_FLOW_ENTRIES)
+            flows.clear();
+        flows.emplace(key, flow);
+        return 0;
+    }
+    int r = honeypot_flow_segment(&it->second, payload, data_end, len, seq, &kexed);
+    if (r == HONEYPOT_KEX_SHORT) {
+        it->second.state = HONEYPOT_FLOW_OPAQUE;
+        it->second.next_seq = seq + len;
+        return 0;
+    }
+    return r > 0;
+}
+#endif
+
+#endif // OMNICLAW_HONEYPOT_CORE_H
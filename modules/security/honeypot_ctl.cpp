@@ -0,0 +1,870 @@
+// modules/security/honeypot_ctl.cpp — runtime control of the pinned honeypot maps
+//
+// Build: clang++ -O2 -std=c++17 honeypot_ctl.cpp -lbpf -o honeypot-ctl
+// Usage: honeypot-ctl info
+//        honeypot-ctl resize <entries>
+//        honeypot-ctl rotate [--every <seconds>]
+//        honeypot-ctl iface <ifname> [--enforce|--monitor|--bypass] [--threshold <n>] [--clear]
+//        honeypot-ctl ifaces
+//        honeypot-ctl fingerprints [--top <n>]
+//        honeypot-ctl fp-limit <id> <syns-per-second>|--clear
+//        honeypot-ctl hassh [--top <n>]
+//        honeypot-ctl hassh-policy <id> [--shadow] [--drop] | --clear
+//        honeypot-ctl scan [--window <seconds>] [--ports <n>] [--hosts <n>] [--on|--off]
+//        honeypot-ctl scans [--top <n>]
+//        honeypot-ctl guard [--baseline <syns-per-second>] [--floor <n>] [--on|--off]
+//
+// resize grows (or shrinks) the attack_map counter tables without reloading
+// the program: per epoch slot a new LRU table is created, the current
+// counters are copied in with batched ops, the slot is pointed at it in one
+// atomic update, and hits the old table took during the copy are folded in
+// afterwards. When shrinking, the highest counts are the ones kept.
+//
+// rotate ends the current counting window: honeypot_cfg.epoch advances by
+// one (the only write the packet path ever observes), and the table that
+// just fell out of the window is replaced by an empty one. The kernel frees
+// the retired table on its own; nothing deletes keys one by one.
+//
+// iface sets how the program treats one of the interfaces it is attached
+// to (if_config): enforce (the default), monitor (count only) or bypass,
+// and a threshold overriding the global one; --clear restores both
+// defaults. ifaces lists every interface the program has seen with its
+// settings and if_stats counters summed over CPUs.
+//
+// fingerprints lists the SYN fingerprints seen on port 22 (fp_stats), the
+// busiest first, in a p0f-like notation: initial TTL, DF, window, MSS,
+// window scale and the option kinds in order. fp-limit caps the SSH SYNs
+// per second one fingerprint gets on enforcing interfaces; the excess is
+// dropped whatever the source address.
+//
+// hassh lists the client fingerprints (hash of the KEXINIT's kex, cipher,
+// MAC and compression lists, HASSH-style but FNV-1a rather than MD5) with
+// the connections that sent them. hassh-policy acts on new connections of
+// one fingerprint on enforcing interfaces: --shadow flags the source so
+// its later connections reach the shadow shell, --drop drops the rest of
+// the connection. Connections already past their KEXINIT keep the policy
+// they were given.
+//
+// scan sets the port-scan detector (scan_cfg): a source probing --ports
+// distinct ports or --hosts distinct addresses within --window seconds is
+// flagged on enforcing interfaces; 0 restores a default, --off stops
+// flagging. Without options it prints the settings. scans lists the
+// sources probing in their current window, the widest first. Both counts
+// are bits set in hashed bitmaps and read slightly low.
+//
+// guard sets the SYN-flood guard (syn_guard_cfg) and prints its state:
+// above --baseline SSH SYNs per second the per-source threshold shrinks in
+// proportion, down to --floor, and only a sample of new sources is
+// counted. 0 restores a default; --off keeps the threshold fixed.
+
+#include <arpa/inet.h>
+#include <bpf/bpf.h>
+#include <bpf/bpf_endian.h>
+#include <bpf/libbpf.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "honeypot.h"
+#include "honeypot_core.h"
+#include "honeypot_maps.h"
+
+namespace {
+
+struct offender {
+    uint32_t src_ip;
+    uint32_t count;
+};
+
+int open_pinned(const char *pin) {
+    int fd = bpf_obj_get(pin);
+    if (fd < 0)
+        fprintf(stderr, "[honeypot-ctl] %s: %s (run honeypot-loader attach first)\n",
+                pin, strerror(errno));
+    return fd;
+}
+
+int table_info(int table_fd, bpf_map_info &info) {
+    info = {};
+    __u32 len = sizeof(info);
+    return bpf_obj_get_info_by_fd(table_fd, &info, &len) ? -errno : 0;
+}
+
+// Same type, key, value and flags as a running table, which is all the
+// kernel compares when a map is placed into attack_map.
+int create_table_like(const bpf_map_info &info, uint32_t entries) {
+    bpf_map_create_opts opts{};
+    opts.sz = sizeof(opts);
+    opts.map_flags = info.map_flags;
+    int fd = bpf_map_create(static_cast<bpf_map_type>(info.type), "attack_table",
+                            info.key_size, info.value_size, entries, &opts);
+    return fd < 0 ? -errno : fd;
+}
+
+int set_slot(int holder, __u32 slot, int table_fd) {
+    __u32 fd = static_cast<__u32>(table_fd);
+    return bpf_map_update_elem(holder, &slot, &fd, BPF_ANY) ? -errno : 0;
+}
+
+int push_batch(int table_fd, const std::vector<offender> &recs) {
+    std::vector<uint32_t> keys(kHoneypotBatch), vals(kHoneypotBatch);
+    bpf_map_batch_opts opts{};
+    opts.sz = sizeof(opts);
+    for (size_t off = 0; off < recs.size();) {
+        uint32_t n = static_cast<uint32_t>(std::min<size_t>(kHoneypotBatch, recs.size() - off));
+        for (uint32_t i = 0; i < n; i++) {
+            keys[i] = recs[off + i].src_ip;
+            vals[i] = recs[off + i].count;
+        }
+        if (bpf_map_update_batch(table_fd, keys.data(), vals.data(), &n, &opts))
+            return -errno;
+        off += n;
+    }
+    return 0;
+}
+
+int cmd_info(int holder, int cfg) {
+    int epoch = honeypot_current_epoch(cfg);
+    if (epoch < 0) {
+        fprintf(stderr, "[honeypot-ctl] honeypot_cfg: %s\n", strerror(-epoch));
+        return epoch;
+    }
+    printf("[honeypot-ctl] attack_map: epoch %d of %d\n", epoch, HONEYPOT_EPOCHS);
+    for (__u32 slot = 0; slot < HONEYPOT_EPOCHS; slot++) {
+        int table = honeypot_open_table(holder, slot);
+        if (table < 0) {
+            printf("  slot %u: %s\n", slot, strerror(-table));
+            continue;
+        }
+        bpf_map_info info;
+        std::vector<offender> recs;
+        int err = table_info(table, info);
+        if (!err)
+            err = honeypot_dump_table(table, recs);
+        close(table);
+        if (err) {
+            fprintf(stderr, "[honeypot-ctl] slot %u: %s\n", slot, strerror(-err));
+            return err;
+        }
+        const char *role = slot == static_cast<__u32>(epoch) ? "current"
+                         : slot == honeypot_prev_epoch(epoch) ? "previous" : "retired";
+        printf("  slot %u (%s): table id %u, %zu/%u entries in use\n",
+               slot, role, info.id, recs.size(), info.max_entries);
+    }
+    return 0;
+}
+
+int resize_slot(int holder, __u32 slot, uint32_t entries) {
+    auto t0 = std::chrono::steady_clock::now();
+    int old_fd = honeypot_open_table(holder, slot);
+    if (old_fd < 0) {
+        fprintf(stderr, "[honeypot-ctl] slot %u: %s\n", slot, strerror(-old_fd));
+        return old_fd;
+    }
+    bpf_map_info old_info;
+    int err = table_info(old_fd, old_info);
+    if (err) {
+        close(old_fd);
+        return err;
+    }
+    int new_fd = create_table_like(old_info, entries);
+    if (new_fd < 0) {
+        fprintf(stderr, "[honeypot-ctl] create %u-entry table: %s\n", entries, strerror(-new_fd));
+        close(old_fd);
+        return new_fd;
+    }
+
+    std::vector<offender> snap;
+    err = honeypot_dump_table(old_fd, snap);
+    if (!err && snap.size() > entries) {
+        std::nth_element(snap.begin(), snap.begin() + entries, snap.end(),
+                         [](const offender &a, const offender &b) { return a.count > b.count; });
+        snap.resize(entries);
+    }
+    if (!err)
+        err = push_batch(new_fd, snap);
+
+    if (!err)
+        err = set_slot(holder, slot, new_fd);
+    if (err) {
+        fprintf(stderr, "[honeypot-ctl] resize slot %u: %s (old table left in place)\n",
+                slot, strerror(-err));
+        close(new_fd);
+        close(old_fd);
+        return err;
+    }
+
+    // Fold in what the old table counted between the dump and the swap.
+    // New traffic already lands in the new table, so only the difference
+    // is added on top of whatever it holds now.
+    std::unordered_map<uint32_t, uint32_t> copied;
+    copied.reserve(snap.size());
+    for (const auto &r : snap)
+        copied.emplace(r.src_ip, r.count);
+    std::vector<offender> after;
+    size_t folded = 0;
+    if (!honeypot_dump_table(old_fd, after)) {
+        for (const auto &r : after) {
+            auto it = copied.find(r.src_ip);
+            uint32_t base = it == copied.end() ? 0 : it->second;
+            if (r.count <= base)
+                continue;
+            uint32_t cur = 0;
+            bpf_map_lookup_elem(new_fd, &r.src_ip, &cur);
+            cur += r.count - base;
+            if (!bpf_map_update_elem(new_fd, &r.src_ip, &cur, BPF_ANY))
+                folded++;
+        }
+    }
+    close(old_fd);
+    close(new_fd);
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    printf("[honeypot-ctl] slot %u resized %u -> %u entries: %zu migrated, "
+           "%zu caught up, %.1f ms\n",
+           slot, old_info.max_entries, entries, snap.size(), folded, ms);
+    return 0;
+}
+
+int cmd_resize(int holder, uint32_t entries) {
+    for (__u32 slot = 0; slot < HONEYPOT_EPOCHS; slot++) {
+        int err = resize_slot(holder, slot, entries);
+        if (err)
+            return err;
+    }
+    return 0;
+}
+
+// Points a slot at a fresh, empty table of the same shape.
+int refresh_slot(int holder, __u32 slot) {
+    int old_fd = honeypot_open_table(holder, slot);
+    if (old_fd < 0)
+        return old_fd;
+    bpf_map_info info;
+    int err = table_info(old_fd, info);
+    close(old_fd);
+    if (err)
+        return err;
+    int fd = create_table_like(info, info.max_entries);
+    if (fd < 0)
+        return fd;
+    err = set_slot(holder, slot, fd);
+    close(fd);
+    return err;
+}
+
+bool slot_is_empty(int holder, __u32 slot) {
+    int fd = honeypot_open_table(holder, slot);
+    if (fd < 0)
+        return true;
+    __u32 key;
+    bool empty = bpf_map_get_next_key(fd, nullptr, &key) != 0;
+    close(fd);
+    return empty;
+}
+
+int rotate_once(int holder, int cfg) {
+    int epoch = honeypot_current_epoch(cfg);
+    if (epoch < 0)
+        return epoch;
+    __u32 next = (static_cast<__u32>(epoch) + 1) % HONEYPOT_EPOCHS;
+    // Normally emptied by the previous rotation; not if that one was
+    // interrupted, or on the very first rotation of a restored pin.
+    int err = slot_is_empty(holder, next) ? 0 : refresh_slot(holder, next);
+    if (err)
+        return err;
+
+    err = honeypot_cfg_store(cfg, offsetof(honeypot_config, epoch), next);
+    if (err)
+        return err;
+
+    __u32 retired = (next + 1) % HONEYPOT_EPOCHS;
+    err = refresh_slot(holder, retired);
+    if (!err)
+        printf("[honeypot-ctl] rotated to epoch %u, slot %u cleared\n", next, retired);
+    return err;
+}
+
+int cmd_rotate(int holder, int cfg, unsigned every) {
+    for (;;) {
+        int err = rotate_once(holder, cfg);
+        if (err) {
+            fprintf(stderr, "[honeypot-ctl] rotate: %s\n", strerror(-err));
+            return err;
+        }
+        if (!every)
+            return 0;
+        std::this_thread::sleep_for(std::chrono::seconds(every));
+    }
+}
+
+const char *if_mode_name(__u32 mode) {
+    switch (mode) {
+    case HONEYPOT_IF_ENFORCE: return "enforce";
+    case HONEYPOT_IF_MONITOR: return "monitor";
+    case HONEYPOT_IF_BYPASS:  return "bypass";
+    }
+    return "?";
+}
+
+// Read-modify-write of one if_config entry; mode or threshold < 0 keeps
+// the current value.
+int cmd_iface(const char *ifname, int mode, long threshold, bool clear) {
+    unsigned ifindex = if_nametoindex(ifname);
+    if (!ifindex) {
+        fprintf(stderr, "[honeypot-ctl] unknown interface %s\n", ifname);
+        return -ENODEV;
+    }
+    int fd = open_pinned(HONEYPOT_IF_CONFIG_PIN);
+    if (fd < 0)
+        return -ENOENT;
+    __u32 key = ifindex;
+    int err = 0;
+    if (clear) {
+        if (bpf_map_delete_elem(fd, &key) && errno != ENOENT)
+            err = -errno;
+    } else {
+        honeypot_if_config conf{};
+        bpf_map_lookup_elem(fd, &key, &conf);
+        if (mode >= 0)
+            conf.mode = static_cast<__u32>(mode);
+        if (threshold >= 0)
+            conf.threshold = static_cast<__u32>(threshold);
+        if (bpf_map_update_elem(fd, &key, &conf, BPF_ANY))
+            err = -errno;
+        else
+            printf("[honeypot-ctl] %s: %s, threshold %s%u\n", ifname, if_mode_name(conf.mode),
+                   conf.threshold ? "" : "global ", conf.threshold);
+    }
+    if (err)
+        fprintf(stderr, "[honeypot-ctl] %s: %s\n", ifname, strerror(-err));
+    close(fd);
+    return err;
+}
+
+int cmd_ifaces() {
+    int conf_fd = open_pinned(HONEYPOT_IF_CONFIG_PIN);
+    int stats_fd = conf_fd < 0 ? -1 : open_pinned(HONEYPOT_IF_STATS_PIN);
+    if (stats_fd < 0) {
+        if (conf_fd >= 0)
+            close(conf_fd);
+        return -ENOENT;
+    }
+    int ncpus = libbpf_num_possible_cpus();
+    std::vector<honeypot_if_stats> per_cpu(static_cast<size_t>(ncpus > 0 ? ncpus : 1));
+    printf("%-16s %-8s %9s %14s %14s %10s %10s\n",
+           "interface", "mode", "threshold", "packets", "ssh", "flagged", "dropped");
+    // Every interface with traffic has counters; configured ones without
+    // traffic yet are listed from if_config.
+    std::vector<__u32> keys;
+    for (int fd : {stats_fd, conf_fd}) {
+        __u32 key, next;
+        for (int err = bpf_map_get_next_key(fd, nullptr, &next); !err;
+             err = bpf_map_get_next_key(fd, &key, &next)) {
+            if (std::find(keys.begin(), keys.end(), next) == keys.end())
+                keys.push_back(next);
+            key = next;
+        }
+    }
+    for (__u32 ifindex : keys) {
+        honeypot_if_config conf{};
+        bpf_map_lookup_elem(conf_fd, &ifindex, &conf);
+        honeypot_if_stats sum{};
+        if (!bpf_map_lookup_elem(stats_fd, &ifindex, per_cpu.data())) {
+            for (const honeypot_if_stats &st : per_cpu) {
+                sum.packets += st.packets;
+                sum.ssh += st.ssh;
+                sum.flagged += st.flagged;
+                sum.dropped += st.dropped;
+            }
+        }
+        char name[IF_NAMESIZE];
+        if (!if_indextoname(ifindex, name))
+            snprintf(name, sizeof(name), "ifindex %u", ifindex);
+        char threshold[16] = "global";
+        if (conf.threshold)
+            snprintf(threshold, sizeof(threshold), "%u", conf.threshold);
+        printf("%-16s %-8s %9s %14llu %14llu %10llu %10llu\n", name, if_mode_name(conf.mode),
+               threshold, static_cast<unsigned long long>(sum.packets),
+               static_cast<unsigned long long>(sum.ssh), static_cast<unsigned long long>(sum.flagged),
+               static_cast<unsigned long long>(sum.dropped));
+    }
+    close(stats_fd);
+    close(conf_fd);
+    return 0;
+}
+
+// p0f-style list of option kinds: mss,sok,ts,nop,ws.
+std::string option_list(const honeypot_syn_fp &sig) {
+    std::string out;
+    for (unsigned i = 0; i < sig.nopts && i < HONEYPOT_FP_MAX_OPTS; i++) {
+        if (!out.empty())
+            out += ',';
+        switch (sig.opts[i]) {
+        case 1:  out += "nop"; break;
+        case 2:  out += "mss"; break;
+        case 3:  out += "ws"; break;
+        case 4:  out += "sok"; break;
+        case 5:  out += "sack"; break;
+        case 8:  out += "ts"; break;
+        default: out += "?" + std::to_string(sig.opts[i]); break;
+        }
+    }
+    return out.empty() ? "-" : out;
+}
+
+int cmd_fingerprints(size_t top) {
+    int stats_fd = open_pinned(HONEYPOT_FP_STATS_PIN);
+    int limits_fd = stats_fd < 0 ? -1 : open_pinned(HONEYPOT_FP_LIMITS_PIN);
+    if (limits_fd < 0) {
+        if (stats_fd >= 0)
+            close(stats_fd);
+        return -ENOENT;
+    }
+    std::vector<std::pair<__u32, honeypot_fp_stats>> fps;
+    __u32 key, next;
+    for (int err = bpf_map_get_next_key(stats_fd, nullptr, &next); !err;
+         err = bpf_map_get_next_key(stats_fd, &key, &next)) {
+        honeypot_fp_stats st;
+        if (!bpf_map_lookup_elem(stats_fd, &next, &st))
+            fps.emplace_back(next, st);
+        key = next;
+    }
+    std::sort(fps.begin(), fps.end(),
+              [](const auto &a, const auto &b) { return a.second.syns > b.second.syns; });
+    if (top && fps.size() > top)
+        fps.resize(top);
+
+    printf("%-8s %-4s %-2s %6s %5s %3s %-24s %12s %12s %8s\n",
+           "id", "ttl", "df", "window", "mss", "ws", "options", "syns", "throttled", "limit/s");
+    for (const auto &[id, st] : fps) {
+        char ws[8] = "-", limit_str[16] = "-";
+        if (st.sig.wscale != 0xff)
+            snprintf(ws, sizeof(ws), "%u", st.sig.wscale);
+        __u32 limit;
+        if (!bpf_map_lookup_elem(limits_fd, &id, &limit))
+            snprintf(limit_str, sizeof(limit_str), "%u", limit);
+        printf("%08x %-4u %-2s %6u %5u %3s %-24s %12llu %12llu %8s\n", id, st.sig.ttl,
+               st.sig.df ? "df" : "-", st.sig.window, st.sig.mss, ws, option_list(st.sig).c_str(),
+               static_cast<unsigned long long>(st.syns), static_cast<unsigned long long>(st.throttled),
+               limit_str);
+    }
+    close(limits_fd);
+    close(stats_fd);
+    return 0;
+}
+
+// limit < 0 removes the cap.
+int cmd_fp_limit(__u32 id, long limit) {
+    int fd = open_pinned(HONEYPOT_FP_LIMITS_PIN);
+    if (fd < 0)
+        return -ENOENT;
+    int err = 0;
+    if (limit < 0) {
+        if (bpf_map_delete_elem(fd, &id) && errno != ENOENT)
+            err = -errno;
+    } else {
+        __u32 value = static_cast<__u32>(limit);
+        if (bpf_map_update_elem(fd, &id, &value, BPF_ANY))
+            err = -errno;
+    }
+    if (err)
+        fprintf(stderr, "[honeypot-ctl] fingerprint %08x: %s\n", id, strerror(-err));
+    else if (limit < 0)
+        printf("[honeypot-ctl] fingerprint %08x: no limit\n", id);
+    else
+        printf("[honeypot-ctl] fingerprint %08x: %ld SYNs/s\n", id, limit);
+    close(fd);
+    return err;
+}
+
+std::string hassh_policy_name(__u32 policy) {
+    std::string out;
+    if (policy & HONEYPOT_HASSH_SHADOW)
+        out = "shadow";
+    if (policy & HONEYPOT_HASSH_DROP)
+        out += out.empty() ? "drop" : ",drop";
+    return out.empty() ? "-" : out;
+}
+
+int cmd_hassh(size_t top) {
+    int stats_fd = open_pinned(HONEYPOT_HASSH_STATS_PIN);
+    int policy_fd = stats_fd < 0 ? -1 : open_pinned(HONEYPOT_HASSH_POLICY_PIN);
+    if (policy_fd < 0) {
+        if (stats_fd >= 0)
+            close(stats_fd);
+        return -ENOENT;
+    }
+    std::vector<std::pair<__u32, honeypot_hassh_stats>> seen;
+    __u32 key, next;
+    for (int err = bpf_map_get_next_key(stats_fd, nullptr, &next); !err;
+         err = bpf_map_get_next_key(stats_fd, &key, &next)) {
+        honeypot_hassh_stats st;
+        if (!bpf_map_lookup_elem(stats_fd, &next, &st))
+            seen.emplace_back(next, st);
+        key = next;
+    }
+    std::sort(seen.begin(), seen.end(),
+              [](const auto &a, const auto &b) { return a.second.flows > b.second.flows; });
+    if (top && seen.size() > top)
+        seen.resize(top);
+
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t now_ns = static_cast<uint64_t>(now.tv_sec) * 1000000000ull + static_cast<uint64_t>(now.tv_nsec);
+    printf("%-8s %12s %10s %-12s\n", "hassh", "connections", "last (s)", "policy");
+    for (const auto &[id, st] : seen) {
+        __u32 policy = 0;
+        bpf_map_lookup_elem(policy_fd, &id, &policy);
+        printf("%08x %12llu %10llu %-12s\n", id, static_cast<unsigned long long>(st.flows),
+               static_cast<unsigned long long>(now_ns > st.last_ns ? (now_ns - st.last_ns) / 1000000000ull : 0),
+               hassh_policy_name(policy).c_str());
+    }
+    close(policy_fd);
+    close(stats_fd);
+    return 0;
+}
+
+// policy 0 removes the entry.
+int cmd_hassh_policy(__u32 id, __u32 policy) {
+    int fd = open_pinned(HONEYPOT_HASSH_POLICY_PIN);
+    if (fd < 0)
+        return -ENOENT;
+    int err = 0;
+    if (!policy) {
+        if (bpf_map_delete_elem(fd, &id) && errno != ENOENT)
+            err = -errno;
+    } else if (bpf_map_update_elem(fd, &id, &policy, BPF_ANY)) {
+        err = -errno;
+    }
+    if (err)
+        fprintf(stderr, "[honeypot-ctl] hassh %08x: %s\n", id, strerror(-err));
+    else
+        printf("[honeypot-ctl] hassh %08x: %s\n", id, hassh_policy_name(policy).c_str());
+    close(fd);
+    return err;
+}
+
+// Negative values keep the current setting; off < 0 likewise.
+int cmd_scan(long window_s, long max_ports, long max_hosts, int off) {
+    int fd = open_pinned(HONEYPOT_SCAN_CFG_PIN);
+    if (fd < 0)
+        return -ENOENT;
+    __u32 zero = 0;
+    honeypot_scan_config sc{};
+    int err = bpf_map_lookup_elem(fd, &zero, &sc) ? -errno : 0;
+    if (!err && (window_s >= 0 || max_ports >= 0 || max_hosts >= 0 || off >= 0)) {
+        if (window_s >= 0)
+            sc.window_s = static_cast<__u32>(window_s);
+        if (max_ports >= 0)
+            sc.max_ports = static_cast<__u32>(max_ports);
+        if (max_hosts >= 0)
+            sc.max_hosts = static_cast<__u32>(max_hosts);
+        if (off >= 0)
+            sc.off = static_cast<__u32>(off);
+        if (bpf_map_update_elem(fd, &zero, &sc, BPF_ANY))
+            err = -errno;
+    }
+    if (err)
+        fprintf(stderr, "[honeypot-ctl] scan_cfg: %s\n", strerror(-err));
+    else
+        printf("[honeypot-ctl] scan: %s, window %us, ports %u, hosts %u\n", sc.off ? "off" : "on",
+               sc.window_s ? sc.window_s : HONEYPOT_SCAN_WINDOW_S,
+               sc.max_ports ? sc.max_ports : HONEYPOT_SCAN_MAX_PORTS,
+               sc.max_hosts ? sc.max_hosts : HONEYPOT_SCAN_MAX_HOSTS);
+    close(fd);
+    return err;
+}
+
+int cmd_scans(size_t top) {
+    int fd = open_pinned(HONEYPOT_SCAN_STATE_PIN);
+    if (fd < 0)
+        return -ENOENT;
+    std::vector<std::pair<__u32, honeypot_scan>> seen;
+    __u32 key, next;
+    for (int err = bpf_map_get_next_key(fd, nullptr, &next); !err;
+         err = bpf_map_get_next_key(fd, &key, &next)) {
+        honeypot_scan sc;
+        if (!bpf_map_lookup_elem(fd, &next, &sc))
+            seen.emplace_back(next, sc);
+        key = next;
+    }
+    auto width = [](const honeypot_scan &sc) { return std::max(sc.nports, sc.nhosts); };
+    std::sort(seen.begin(), seen.end(),
+              [&](const auto &a, const auto &b) { return width(a.second) > width(b.second); });
+    if (top && seen.size() > top)
+        seen.resize(top);
+
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t now_ns = static_cast<uint64_t>(now.tv_sec) * 1000000000ull + static_cast<uint64_t>(now.tv_nsec);
+    printf("%-15s %6s %6s %10s\n", "source", "ports", "hosts", "window (s)");
+    for (const auto &[src, sc] : seen) {
+        char ip[INET_ADDRSTRLEN];
+        in_addr addr{src};
+        inet_ntop(AF_INET, &addr, ip, sizeof(ip));
+        printf("%-15s %6u %6u %10llu\n", ip, sc.nports, sc.nhosts,
+               static_cast<unsigned long long>(now_ns > sc.window_ns ? (now_ns - sc.window_ns) / 1000000000ull : 0));
+    }
+    close(fd);
+    return 0;
+}
+
+// Negative values keep the current setting; off < 0 likewise.
+int cmd_guard(long baseline, long floor, int off) {
+    int cfg_fd = open_pinned(HONEYPOT_GUARD_CFG_PIN);
+    int state_fd = cfg_fd < 0 ? -1 : open_pinned(HONEYPOT_GUARD_PIN);
+    int cpu_fd = state_fd < 0 ? -1 : open_pinned(HONEYPOT_GUARD_CPU_PIN);
+    int cfg = cpu_fd < 0 ? -1 : open_pinned(HONEYPOT_CFG_PIN);
+    if (cfg < 0) {
+        if (cpu_fd >= 0)
+            close(cpu_fd);
+        if (state_fd >= 0)
+            close(state_fd);
+        if (cfg_fd >= 0)
+            close(cfg_fd);
+        return -ENOENT;
+    }
+    __u32 zero = 0;
+    honeypot_guard_config gc{};
+    honeypot_guard g{};
+    honeypot_config c{};
+    int ncpus = libbpf_num_possible_cpus();
+    std::vector<honeypot_guard_cpu> per_cpu(static_cast<size_t>(ncpus > 0 ? ncpus : 1));
+    int err = bpf_map_lookup_elem(cfg_fd, &zero, &gc) || bpf_map_lookup_elem(state_fd, &zero, &g) ||
+              bpf_map_lookup_elem(cpu_fd, &zero, per_cpu.data()) ||
+              bpf_map_lookup_elem(cfg, &zero, &c) ? -errno : 0;
+    if (!err && (baseline >= 0 || floor >= 0 || off >= 0)) {
+        if (baseline >= 0)
+            gc.baseline = static_cast<__u32>(baseline);
+        if (floor >= 0)
+            gc.floor = static_cast<__u32>(floor);
+        if (off >= 0)
+            gc.off = static_cast<__u32>(off);
+        if (bpf_map_update_elem(cfg_fd, &zero, &gc, BPF_ANY))
+            err = -errno;
+    }
+    if (err) {
+        fprintf(stderr, "[honeypot-ctl] syn_guard: %s\n", strerror(-err));
+    } else {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint64_t now_ns = static_cast<uint64_t>(now.tv_sec) * 1000000000ull + static_cast<uint64_t>(now.tv_nsec);
+        honeypot_guard_view v{};
+        if (now_ns - g.tick_ns < HONEYPOT_GUARD_STALE * HONEYPOT_GUARD_TICK_NS)
+            v.rate = g.rate;
+        v.baseline = gc.baseline ? gc.baseline : HONEYPOT_GUARD_BASELINE;
+        v.floor = gc.floor ? gc.floor : HONEYPOT_GUARD_FLOOR;
+        __u32 threshold = c.threshold ? c.threshold : HONEYPOT_DEFAULT_THRESHOLD;
+        uint64_t not_admitted = 0;
+        for (const honeypot_guard_cpu &pc : per_cpu)
+            not_admitted += pc.not_admitted;
+        printf("[honeypot-ctl] guard: %s, baseline %u SYNs/s, floor %u\n", gc.off ? "off" : "on",
+               v.baseline, v.floor);
+        printf("[honeypot-ctl] SSH SYN rate %llu/s, threshold %u (configured %u), %llu SYNs of new sources not admitted\n",
+               static_cast<unsigned long long>(v.rate >> HONEYPOT_GUARD_SHIFT),
+               gc.off ? threshold : honeypot_guard_threshold(threshold, &v), threshold,
+               static_cast<unsigned long long>(not_admitted));
+    }
+    close(cfg);
+    close(cpu_fd);
+    close(state_fd);
+    close(cfg_fd);
+    return err;
+}
+
+void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s info\n"
+            "       %s resize <entries>\n"
+            "       %s rotate [--every <seconds>]\n"
+            "       %s iface <ifname> [--enforce|--monitor|--bypass] [--threshold <n>] [--clear]\n"
+            "       %s ifaces\n"
+            "       %s fingerprints [--top <n>]\n"
+            "       %s fp-limit <id> <syns-per-second>|--clear\n"
+            "       %s hassh [--top <n>]\n"
+            "       %s hassh-policy <id> [--shadow] [--drop] | --clear\n"
+            "       %s scan [--window <seconds>] [--ports <n>] [--hosts <n>] [--on|--off]\n"
+            "       %s scans [--top <n>]\n"
+            "       %s guard [--baseline <syns-per-second>] [--floor <n>] [--on|--off]\n",
+            argv0, argv0, argv0, argv0, argv0, argv0, argv0, argv0, argv0, argv0, argv0, argv0);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        usage(argv[0]);
+        return 2;
+    }
+    const std::string cmd = argv[1];
+    unsigned long top = 0;
+    bool listing = argc == 2 || (argc == 4 && !strcmp(argv[2], "--top") &&
+                                 honeypot_parse_num(argv[3], 10, 1, SIZE_MAX, top));
+    if (cmd == "ifaces" && argc == 2)
+        return cmd_ifaces() ? 1 : 0;
+    if (cmd == "fingerprints" && listing)
+        return cmd_fingerprints(top) ? 1 : 0;
+    if (cmd == "fp-limit" && argc == 4) {
+        unsigned long id, limit = 0;
+        bool clear = !strcmp(argv[3], "--clear");
+        if (!honeypot_parse_num(argv[2], 16, 0, UINT32_MAX, id) ||
+            (!clear && !honeypot_parse_num(argv[3], 10, 0, UINT32_MAX, limit))) {
+            usage(argv[0]);
+            return 2;
+        }
+        return cmd_fp_limit(static_cast<__u32>(id), clear ? -1 : static_cast<long>(limit)) ? 1 : 0;
+    }
+    if (cmd == "hassh" && listing)
+        return cmd_hassh(top) ? 1 : 0;
+    if (cmd == "hassh-policy" && argc >= 4) {
+        unsigned long id;
+        __u32 policy = 0;
+        bool clear = false;
+        if (!honeypot_parse_num(argv[2], 16, 0, UINT32_MAX, id)) {
+            usage(argv[0]);
+            return 2;
+        }
+        for (int i = 3; i < argc; i++) {
+            if (!strcmp(argv[i], "--shadow")) {
+                policy |= HONEYPOT_HASSH_SHADOW;
+            } else if (!strcmp(argv[i], "--drop")) {
+                policy |= HONEYPOT_HASSH_DROP;
+            } else if (!strcmp(argv[i], "--clear")) {
+                clear = true;
+            } else {
+                usage(argv[0]);
+                return 2;
+            }
+        }
+        if (clear == !!policy) {
+            usage(argv[0]);
+            return 2;
+        }
+        return cmd_hassh_policy(static_cast<__u32>(id), policy) ? 1 : 0;
+    }
+    if (cmd == "scans" && listing)
+        return cmd_scans(top) ? 1 : 0;
+    if (cmd == "scan") {
+        long window_s = -1, max_ports = -1, max_hosts = -1;
+        int off = -1;
+        for (int i = 2; i < argc; i++) {
+            unsigned long v;
+            // The bitmaps hold 256 ports and 128 hosts; a larger limit
+            // could never be reached.
+            if (!strcmp(argv[i], "--window") && i + 1 < argc &&
+                honeypot_parse_num(argv[i + 1], 10, 0, UINT32_MAX, v)) {
+                window_s = static_cast<long>(v);
+                i++;
+            } else if (!strcmp(argv[i], "--ports") && i + 1 < argc &&
+                       honeypot_parse_num(argv[i + 1], 10, 0, 256, v)) {
+                max_ports = static_cast<long>(v);
+                i++;
+            } else if (!strcmp(argv[i], "--hosts") && i + 1 < argc &&
+                       honeypot_parse_num(argv[i + 1], 10, 0, 128, v)) {
+                max_hosts = static_cast<long>(v);
+                i++;
+            } else if (!strcmp(argv[i], "--on")) {
+                off = 0;
+            } else if (!strcmp(argv[i], "--off")) {
+                off = 1;
+            } else {
+                usage(argv[0]);
+                return 2;
+            }
+        }
+        return cmd_scan(window_s, max_ports, max_hosts, off) ? 1 : 0;
+    }
+    if (cmd == "guard") {
+        long baseline = -1, floor = -1;
+        int off = -1;
+        for (int i = 2; i < argc; i++) {
+            unsigned long v;
+            if (!strcmp(argv[i], "--baseline") && i + 1 < argc &&
+                honeypot_parse_num(argv[i + 1], 10, 0, UINT32_MAX, v)) {
+                baseline = static_cast<long>(v);
+                i++;
+            } else if (!strcmp(argv[i], "--floor") && i + 1 < argc &&
+                       honeypot_parse_num(argv[i + 1], 10, 0, UINT32_MAX, v)) {
+                floor = static_cast<long>(v);
+                i++;
+            } else if (!strcmp(argv[i], "--on")) {
+                off = 0;
+            } else if (!strcmp(argv[i], "--off")) {
+                off = 1;
+            } else {
+                usage(argv[0]);
+                return 2;
+            }
+        }
+        return cmd_guard(baseline, floor, off) ? 1 : 0;
+    }
+    if (cmd == "iface" && argc >= 3) {
+        int mode = -1;
+        long threshold = -1;
+        bool clear = false;
+        for (int i = 3; i < argc; i++) {
+            unsigned long v;
+            if (!strcmp(argv[i], "--enforce")) {
+                mode = HONEYPOT_IF_ENFORCE;
+            } else if (!strcmp(argv[i], "--monitor")) {
+                mode = HONEYPOT_IF_MONITOR;
+            } else if (!strcmp(argv[i], "--bypass")) {
+                mode = HONEYPOT_IF_BYPASS;
+            } else if (!strcmp(argv[i], "--threshold") && i + 1 < argc &&
+                       honeypot_parse_num(argv[i + 1], 10, 0, UINT32_MAX, v)) {
+                threshold = static_cast<long>(v);
+                i++;
+            } else if (!strcmp(argv[i], "--clear")) {
+                clear = true;
+            } else {
+                usage(argv[0]);
+                return 2;
+            }
+        }
+        return cmd_iface(argv[2], mode, threshold, clear) ? 1 : 0;
+    }
+    unsigned long entries = 0, every = 0;
+    if (cmd == "resize") {
+        if (argc != 3 || !honeypot_parse_num(argv[2], 10, 1, UINT32_MAX, entries)) {
+            usage(argv[0]);
+            return 2;
+        }
+    } else if (cmd == "rotate" && argc == 4 && !strcmp(argv[2], "--every")) {
+        if (!honeypot_parse_num(argv[3], 10, 1, UINT32_MAX, every)) {
+            usage(argv[0]);
+            return 2;
+        }
+    } else if ((cmd != "info" && cmd != "rotate") || argc != 2) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int holder = open_pinned(HONEYPOT_ATTACK_MAP_PIN);
+    int cfg = holder < 0 ? -1 : open_pinned(HONEYPOT_CFG_PIN);
+    if (cfg < 0)
+        return 1;
+    int err;
+    if (cmd == "info")
+        err = cmd_info(holder, cfg);
+    else if (cmd == "resize")
+        err = cmd_resize(holder, static_cast<uint32_t>(entries));
+    else
+        err = cmd_rotate(holder, cfg, static_cast<unsigned>(every));
+    close(cfg);
+    close(holder);
+    return err ? 1 : 0;
+}
@@ -0,0 +1,328 @@
+// modules/security/honeypot_dispatch.cpp — run the detector under the libxdp dispatcher
+// honeypot-loader owns the XDP hook of an interface through a bpf_link, so
+// attaching it replaces whatever else runs there. On hosts where a load
+// balancer or DDoS filter needs XDP too, this tool installs
+// xdp_ssh_redirect as one component of libxdp's multi-program dispatcher
+// instead: the programs run one after the other in the driver hook, in
+// run-priority order, and each passes the packet on for the actions its
+// chain-call set allows. The defaults come from the XDP_RUN_CONFIG of
+// honeypot.cpp (priority HONEYPOT_XDP_RUN_PRIO, chain on XDP_PASS);
+// --priority and --chain (comma-separated actions: aborted, drop, pass,
+// tx, redirect) override them for this attachment.
+//
+// Maps are shared with the other honeypot tools through the same pins, the
+// event rings are filled as by honeypot-loader, and sk_lookup_shadow gets
+// the namespace link it would get from honeypot-loader attach. An
+// interface is driven by one tool or the other, never both: detach with
+// honeypot-loader before handing it to the dispatcher. Attaching one
+// program to several interfaces needs Linux 5.10 (multi-attach freplace).
+//
+// Build: clang++ -O2 -std=c++17 honeypot_dispatch.cpp -lxdp -lbpf -o honeypot-dispatch
+// Usage: honeypot-dispatch attach <ifname>[,<ifname>...] [honeypot.bpf.o] [--priority <n>]
+//                         [--chain <actions>] [--generic]
+//        honeypot-dispatch detach <ifname>[,<ifname>...]
+//        honeypot-dispatch status <ifname>[,<ifname>...]
+
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+#include <fcntl.h>
+#include <net/if.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <xdp/libxdp.h>
+
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "honeypot.h"
+#include "honeypot_maps.h"
+
+namespace {
+
+const char *kDefaultObject = "honeypot.bpf.o";
+
+struct attach_opts {
+    const char     *obj_path = kDefaultObject;
+    long            priority = -1;      // < 0: the object's XDP_RUN_CONFIG
+    const char     *chain = nullptr;    // nullptr: the object's XDP_RUN_CONFIG
+    xdp_attach_mode mode = XDP_MODE_NATIVE;
+};
+
+std::vector<std::string> split_list(const char *list) {
+    std::vector<std::string> out;
+    std::string cur;
+    for (const char *p = list;; p++) {
+        if (*p == ',' || !*p) {
+            if (!cur.empty())
+                out.push_back(cur);
+            cur.clear();
+            if (!*p)
+                return out;
+        } else {
+            cur += *p;
+        }
+    }
+}
+
+int parse_action(const std::string &name, unsigned &action) {
+    static const struct {
+        const char *name;
+        unsigned    action;
+    } kActions[] = {
+        {"aborted", XDP_ABORTED}, {"drop", XDP_DROP}, {"pass", XDP_PASS},
+        {"tx", XDP_TX}, {"redirect", XDP_REDIRECT},
+    };
+    for (const auto &a : kActions) {
+        if (name == a.name) {
+            action = a.action;
+            return 0;
+        }
+    }
+    return -EINVAL;
+}
+
+// Replaces the chain-call set with exactly the listed actions.
+int set_chain(xdp_program *prog, const char *list) {
+    std::vector<unsigned> actions;
+    for (const std::string &name : split_list(list)) {
+        unsigned action;
+        if (parse_action(name, action)) {
+            fprintf(stderr, "[honeypot-dispatch] unknown XDP action %s\n", name.c_str());
+            return -EINVAL;
+        }
+        actions.push_back(action);
+    }
+    for (unsigned action = XDP_ABORTED; action <= XDP_REDIRECT; action++) {
+        bool on = false;
+        for (unsigned a : actions)
+            on |= a == action;
+        int err = xdp_program__set_chain_call_enabled(prog, action, on);
+        if (err)
+            return err;
+    }
+    return 0;
+}
+
+// Namespace-wide sk_lookup link, pinned like honeypot-loader pins it.
+int attach_steering(bpf_object *obj) {
+    bpf_program *steer = bpf_object__find_program_by_name(obj, HONEYPOT_SK_LOOKUP_PROG);
+    if (!steer)
+        return 0;
+    int prog_fd = bpf_program__fd(steer);
+    int link = bpf_obj_get(HONEYPOT_SK_LOOKUP_LINK);
+    if (link >= 0) {
+        int err = bpf_link_update(link, prog_fd, nullptr) ? -errno : 0;
+        close(link);
+        return err;
+    }
+    int netns = open("/proc/self/ns/net", O_RDONLY | O_CLOEXEC);
+    link = bpf_link_create(prog_fd, netns, BPF_SK_LOOKUP, nullptr);
+    int err = link < 0 || bpf_obj_pin(link, HONEYPOT_SK_LOOKUP_LINK) ? -errno : 0;
+    if (link >= 0)
+        close(link);
+    close(netns);
+    return err;
+}
+
+int cmd_attach(const std::vector<std::string> &ifnames, const attach_opts &o) {
+    std::vector<int> ifindexes;
+    for (const std::string &ifname : ifnames) {
+        int ifindex = static_cast<int>(if_nametoindex(ifname.c_str()));
+        if (!ifindex) {
+            fprintf(stderr, "[honeypot-dispatch] unknown interface %s\n", ifname.c_str());
+            return -ENODEV;
+        }
+        ifindexes.push_back(ifindex);
+    }
+    if (mkdir(HONEYPOT_PIN_ROOT, 0700) && errno != EEXIST) {
+        fprintf(stderr, "[honeypot-dispatch] mkdir %s: %s\n", HONEYPOT_PIN_ROOT, strerror(errno));
+        return -errno;
+    }
+
+    // libxdp loads the object itself, as an extension of its dispatcher;
+    // the pin root makes that load reuse the pinned maps.
+    bpf_object_open_opts opts{};
+    opts.sz = sizeof(opts);
+    opts.pin_root_path = HONEYPOT_PIN_ROOT;
+    bpf_object *obj = bpf_object__open_file(o.obj_path, &opts);
+    if (!obj) {
+        fprintf(stderr, "[honeypot-dispatch] open %s: %s\n", o.obj_path, strerror(errno));
+        return -errno;
+    }
+    int ncpus = libbpf_num_possible_cpus();
+    bpf_map *events = bpf_object__find_map_by_name(obj, HONEYPOT_EVENTS_MAP);
+    if (events && ncpus > 0)
+        bpf_map__set_max_entries(events, static_cast<__u32>(ncpus));
+    // The TC twin is not needed here; it need not load either.
+    bpf_program *tc = bpf_object__find_program_by_name(obj, HONEYPOT_TC_PROG);
+    if (tc)
+        bpf_program__set_autoload(tc, false);
+
+    xdp_program *prog = xdp_program__from_bpf_obj(obj, "xdp");
+    int err = static_cast<int>(libxdp_get_error(prog));
+    if (!err && o.priority >= 0)
+        err = xdp_program__set_run_prio(prog, static_cast<unsigned>(o.priority));
+    if (!err && o.chain)
+        err = set_chain(prog, o.chain);
+    if (err) {
+        fprintf(stderr, "[honeypot-dispatch] %s: %s\n", o.obj_path, strerror(-err));
+        if (!libxdp_get_error(prog))
+            xdp_program__close(prog);
+        bpf_object__close(obj);
+        return err;
+    }
+
+    bool attached = false;
+    for (size_t i = 0; i < ifnames.size(); i++) {
+        int if_err = xdp_program__attach(prog, ifindexes[i], o.mode, 0);
+        if (if_err) {
+            fprintf(stderr, "[honeypot-dispatch] attach %s: %s\n", ifnames[i].c_str(), strerror(-if_err));
+            if (!err)
+                err = if_err;
+            continue;
+        }
+        attached = true;
+        char chain[64] = "";
+        xdp_program__print_chain_call_actions(prog, chain, sizeof(chain));
+        printf("[honeypot-dispatch] %s: %s at priority %u, chain on %s (%s mode)\n",
+               ifnames[i].c_str(), HONEYPOT_PROG_NAME, xdp_program__run_prio(prog), chain,
+               o.mode == XDP_MODE_SKB ? "generic" : "native");
+    }
+
+    if (attached) {
+        if (events && ncpus > 0) {
+            int ring_err = honeypot_fill_rings(bpf_map__fd(events), static_cast<__u32>(ncpus),
+                                               HONEYPOT_EVENTS_BYTES);
+            if (ring_err)
+                fprintf(stderr, "[honeypot-dispatch] event rings: %s\n", strerror(-ring_err));
+        }
+        int steer_err = attach_steering(obj);
+        if (steer_err) {
+            fprintf(stderr, "[honeypot-dispatch] sk_lookup: %s\n", strerror(-steer_err));
+            if (!err)
+                err = steer_err;
+        }
+    }
+    // libxdp pins the dispatcher and its components under bpffs; they
+    // stay attached after we exit.
+    xdp_program__close(prog);
+    bpf_object__close(obj);
+    return err;
+}
+
+// Runs fn on our component of the dispatcher on ifname.
+template <typename Fn>
+int with_component(const char *ifname, Fn fn) {
+    int ifindex = static_cast<int>(if_nametoindex(ifname));
+    if (!ifindex) {
+        fprintf(stderr, "[honeypot-dispatch] unknown interface %s\n", ifname);
+        return -ENODEV;
+    }
+    xdp_multiprog *mp = xdp_multiprog__get_from_ifindex(ifindex);
+    int err = static_cast<int>(libxdp_get_error(mp));
+    if (err) {
+        fprintf(stderr, "[honeypot-dispatch] %s: %s\n", ifname, strerror(-err));
+        return err;
+    }
+    err = -ENOENT;
+    if (!xdp_multiprog__is_legacy(mp)) {
+        for (xdp_program *p = xdp_multiprog__next_prog(nullptr, mp); p; p = xdp_multiprog__next_prog(p, mp)) {
+            if (!strcmp(xdp_program__name(p), HONEYPOT_PROG_NAME)) {
+                err = fn(ifindex, mp, p);
+                break;
+            }
+        }
+    }
+    if (err == -ENOENT)
+        printf("[honeypot-dispatch] %s: %s not in a dispatcher\n", ifname, HONEYPOT_PROG_NAME);
+    xdp_multiprog__close(mp);
+    return err;
+}
+
+int cmd_detach(const char *ifname) {
+    return with_component(ifname, [&](int ifindex, xdp_multiprog *mp, xdp_program *p) {
+        int err = xdp_program__detach(p, ifindex, xdp_multiprog__attach_mode(mp), 0);
+        if (err)
+            fprintf(stderr, "[honeypot-dispatch] detach %s: %s\n", ifname, strerror(-err));
+        else
+            printf("[honeypot-dispatch] %s: detached (maps stay pinned in %s)\n",
+                   ifname, HONEYPOT_PIN_ROOT);
+        return err;
+    });
+}
+
+// Lists every component of the dispatcher, ours marked, in run order.
+int cmd_status(const char *ifname) {
+    return with_component(ifname, [&](int, xdp_multiprog *mp, xdp_program *) {
+        printf("[honeypot-dispatch] %s: %s mode\n", ifname,
+               xdp_multiprog__attach_mode(mp) == XDP_MODE_SKB ? "generic" : "native");
+        for (xdp_program *p = xdp_multiprog__next_prog(nullptr, mp); p; p = xdp_multiprog__next_prog(p, mp)) {
+            char chain[64] = "";
+            xdp_program__print_chain_call_actions(p, chain, sizeof(chain));
+            printf("  %c %-24s priority %-4u chain on %s\n",
+                   strcmp(xdp_program__name(p), HONEYPOT_PROG_NAME) ? ' ' : '*',
+                   xdp_program__name(p), xdp_program__run_prio(p), chain);
+        }
+        return 0;
+    });
+}
+
+void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s attach <ifname>[,<ifname>...] [%s] [--priority <n>] [--chain <actions>] [--generic]\n"
+            "       %s detach <ifname>[,<ifname>...]\n"
+            "       %s status <ifname>[,<ifname>...]\n",
+            argv0, kDefaultObject, argv0, argv0);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        usage(argv[0]);
+        return 2;
+    }
+    const std::string cmd = argv[1];
+    const std::vector<std::string> ifnames = split_list(argv[2]);
+    if (ifnames.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+    int err = 0;
+    if (cmd == "attach") {
+        attach_opts o;
+        for (int i = 3; i < argc; i++) {
+            unsigned long v;
+            if (!strcmp(argv[i], "--priority") && i + 1 < argc &&
+                honeypot_parse_num(argv[i + 1], 10, 0, INT_MAX, v)) {
+                o.priority = static_cast<long>(v);
+                i++;
+            } else if (!strcmp(argv[i], "--chain") && i + 1 < argc) {
+                o.chain = argv[++i];
+            } else if (!strcmp(argv[i], "--generic")) {
+                o.mode = XDP_MODE_SKB;
+            } else if (argv[i][0] != '-') {
+                o.obj_path = argv[i];
+            } else {
+                usage(argv[0]);
+                return 2;
+            }
+        }
+        err = cmd_attach(ifnames, o);
+    } else if ((cmd == "detach" || cmd == "status") && argc == 3) {
+        for (const std::string &ifname : ifnames) {
+            int if_err = cmd == "detach" ? cmd_detach(ifname.c_str()) : cmd_status(ifname.c_str());
+            if (if_err && !err)
+                err = if_err;
+        }
+    } else {
+        usage(argv[0]);
+        return 2;
+    }
+    return err ? 1 : 0;
+}
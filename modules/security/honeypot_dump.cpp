@@ -0,0 +1,163 @@
+// modules/security/honeypot_dump.cpp — stream the offenders of the attack window
+// Runs the bpf_iter programs of honeypot_iter.cpp over the current and the
+// previous counter table and copies the iterator fd to stdout. The kernel
+// walks the tables and drops everything at or under the threshold, so a
+// million-entry table costs one read() per buffer of output rather than a
+// syscall per entry, and nothing is formatted that is not printed.
+// Replaces `bpftool map dump -j` for operators and scripts.
+//
+// Build: clang++ -O2 -std=c++17 honeypot_dump.cpp -lbpf -o honeypot-dump
+// Usage: honeypot-dump [--binary] [--min <count>] [honeypot_iter.bpf.o]
+//
+// Text output is one "a.b.c.d count" line per source; --binary writes
+// struct honeypot_dump_record instead (8 bytes, src_ip in network order).
+
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "honeypot.h"
+#include "honeypot_maps.h"
+
+namespace {
+
+const char *kDefaultObject = "honeypot_iter.bpf.o";
+
+int write_all(int fd, const char *buf, size_t len) {
+    while (len) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -errno;
+        }
+        buf += n;
+        len -= static_cast<size_t>(n);
+    }
+    return 0;
+}
+
+// One pass: the iterator walks table_fd and everything it emits goes to
+// out_fd.
+int run_pass(bpf_program *prog, int params_fd, int table_fd,
+             const honeypot_dump_params &params, int out_fd, std::vector<char> &buf) {
+    __u32 zero = 0;
+    if (bpf_map_update_elem(params_fd, &zero, &params, BPF_ANY))
+        return -errno;
+
+    bpf_iter_link_info info{};
+    info.map.map_fd = static_cast<__u32>(table_fd);
+    bpf_iter_attach_opts opts{};
+    opts.sz = sizeof(opts);
+    opts.link_info = &info;
+    opts.link_info_len = sizeof(info);
+    bpf_link *link = bpf_program__attach_iter(prog, &opts);
+    if (!link)
+        return -errno;
+    int iter = bpf_iter_create(bpf_link__fd(link));
+    int err = iter < 0 ? -errno : 0;
+    while (!err) {
+        ssize_t n = read(iter, buf.data(), buf.size());
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            err = n < 0 ? -errno : 0;
+            break;
+        }
+        err = write_all(out_fd, buf.data(), static_cast<size_t>(n));
+    }
+    if (iter >= 0)
+        close(iter);
+    bpf_link__destroy(link);
+    return err;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const char *obj_path = kDefaultObject;
+    bool binary = false;
+    __u32 min_count = 0;
+    for (int i = 1; i < argc; i++) {
+        unsigned long v;
+        if (!strcmp(argv[i], "--binary")) {
+            binary = true;
+        } else if (!strcmp(argv[i], "--min") && i + 1 < argc &&
+                   honeypot_parse_num(argv[i + 1], 10, 0, UINT32_MAX, v)) {
+            min_count = static_cast<__u32>(v);
+            i++;
+        } else if (argv[i][0] != '-') {
+            obj_path = argv[i];
+        } else {
+            fprintf(stderr, "usage: %s [--binary] [--min <count>] [%s]\n", argv[0], kDefaultObject);
+            return 2;
+        }
+    }
+
+    int holder = bpf_obj_get(HONEYPOT_ATTACK_MAP_PIN);
+    int cfg = bpf_obj_get(HONEYPOT_CFG_PIN);
+    if (holder < 0 || cfg < 0) {
+        fprintf(stderr, "[honeypot-dump] %s: %s (run honeypot-loader attach first)\n",
+                holder < 0 ? HONEYPOT_ATTACK_MAP_PIN : HONEYPOT_CFG_PIN, strerror(errno));
+        return 1;
+    }
+    int epoch = honeypot_current_epoch(cfg);
+    if (epoch < 0) {
+        fprintf(stderr, "[honeypot-dump] honeypot_cfg: %s\n", strerror(-epoch));
+        return 1;
+    }
+
+    // The object must see the pinned maps, not fresh copies of its own.
+    bpf_object *obj = bpf_object__open_file(obj_path, nullptr);
+    if (!obj) {
+        fprintf(stderr, "[honeypot-dump] open %s: %s\n", obj_path, strerror(errno));
+        return 1;
+    }
+    bpf_map *attack_map = bpf_object__find_map_by_name(obj, "attack_map");
+    bpf_map *cfg_map = bpf_object__find_map_by_name(obj, "honeypot_cfg");
+    int err = attack_map && cfg_map ? 0 : -ENOENT;
+    if (!err)
+        err = bpf_map__reuse_fd(attack_map, holder);
+    if (!err)
+        err = bpf_map__reuse_fd(cfg_map, cfg);
+    if (!err)
+        err = bpf_object__load(obj);
+    bpf_program *prog = bpf_object__find_program_by_name(obj, binary ? "dump_binary" : "dump_text");
+    int params_fd = bpf_object__find_map_fd_by_name(obj, "dump_params");
+    if (!err && (!prog || params_fd < 0))
+        err = -ENOENT;
+    if (err) {
+        fprintf(stderr, "[honeypot-dump] load %s: %s\n", obj_path, strerror(-err));
+        bpf_object__close(obj);
+        return 1;
+    }
+
+    std::vector<char> buf(1 << 20);
+    const __u32 current = static_cast<__u32>(epoch), prev = honeypot_prev_epoch(current);
+    const struct {
+        __u32 table, other, skip_shared;
+    } passes[2] = {{current, prev, 0}, {prev, current, 1}};
+    for (const auto &pass : passes) {
+        int table = honeypot_open_table(holder, pass.table);
+        if (table == -ENOENT)
+            continue;
+        if (table < 0) {
+            err = table;
+        } else {
+            honeypot_dump_params params{pass.other, pass.skip_shared, min_count, 0};
+            err = run_pass(prog, params_fd, table, params, STDOUT_FILENO, buf);
+            close(table);
+        }
+        if (err) {
+            fprintf(stderr, "[honeypot-dump] slot %u: %s\n", pass.table, strerror(-err));
+            break;
+        }
+    }
+    bpf_object__close(obj);
+    return err ? 1 : 0;
+}
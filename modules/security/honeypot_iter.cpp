@@ -0,0 +1,121 @@
+// modules/security/honeypot_iter.cpp — bpf_iter dump of the attack window
+// Iterator programs over one attack_map counter table, run by
+// honeypot_dump.cpp. Filtering happens in the kernel: only sources over
+// the threshold in the current window (this epoch plus the previous one,
+// i.e. seen recently) reach the fd, as 8-byte records or as text lines.
+// The reader gets a plain stream, with no per-element syscall and no JSON.
+//
+// Build: clang -O2 -g -target bpf -x c -c honeypot_iter.cpp -o honeypot_iter.bpf.o
+//        (-g: iterators need BTF for their context type)
+//
+// A window takes two passes. Pass one walks the current table and adds
+// each source's count from the previous one; pass two walks the previous
+// table and skips sources pass one already covered.
+
+#include <linux/bpf.h>
+#include <bpf/bpf_helpers.h>
+
+#include "honeypot.h"
+
+// Iterator context, resolved against kernel BTF at load time.
+struct seq_file;
+struct bpf_iter_meta {
+    struct seq_file *seq;
+    __u64 session_id;
+    __u64 seq_num;
+} __attribute__((preserve_access_index));
+
+struct bpf_iter__bpf_map_elem {
+    struct bpf_iter_meta *meta;
+    struct bpf_map *map;
+    void *key;
+    void *value;
+} __attribute__((preserve_access_index));
+
+// Same definitions as honeypot.cpp; honeypot-dump swaps in the pinned maps
+// with bpf_map__reuse_fd() before load.
+struct attack_table {
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
+    __uint(max_entries, HONEYPOT_ATTACK_ENTRIES);
+    __type(key, __u32);
+    __type(value, __u32);
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY_OF_MAPS);
+    __uint(max_entries, HONEYPOT_EPOCHS);
+    __type(key, __u32);
+    __array(values, struct attack_table);
+} attack_map SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, 1);
+    __uint(map_flags, BPF_F_MMAPABLE);
+    __type(key, __u32);
+    __type(value, struct honeypot_config);
+} honeypot_cfg SEC(".maps");
+
+// Pass parameters, written by honeypot-dump before each pass.
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct honeypot_dump_params);
+} dump_params SEC(".maps");
+
+static __always_inline int select_source(struct bpf_iter__bpf_map_elem *ctx, struct honeypot_dump_record *rec) {
+    __u32 *key = ctx->key;
+    __u32 *val = ctx->value;
+    if (!key || !val)
+        return 0;           // end of the table
+    __u32 zero = 0;
+    struct honeypot_dump_params *p = bpf_map_lookup_elem(&dump_params, &zero);
+    if (!p)
+        return 0;
+
+    // The key buffer is read-only to helpers; look it up from the stack.
+    __u32 src_ip = *key;
+    __u32 total = *val;
+    void *other = bpf_map_lookup_elem(&attack_map, &p->other_slot);
+    if (other) {
+        __u32 *count = bpf_map_lookup_elem(other, &src_ip);
+        if (count) {
+            if (p->skip_shared)
+                return 0;
+            total += *count;
+        }
+    }
+
+    __u32 threshold = p->min_count;
+    if (!threshold) {
+        struct honeypot_config *cfg = bpf_map_lookup_elem(&honeypot_cfg, &zero);
+        threshold = cfg && cfg->threshold ? cfg->threshold : HONEYPOT_DEFAULT_THRESHOLD;
+    }
+    if (total <= threshold)
+        return 0;
+    rec->src_ip = src_ip;
+    rec->count = total;
+    return 1;
+}
+
+SEC("iter/bpf_map_elem")
+int dump_binary(struct bpf_iter__bpf_map_elem *ctx) {
+    struct honeypot_dump_record rec;
+    if (select_source(ctx, &rec))
+        bpf_seq_write(ctx->meta->seq, &rec, sizeof(rec));
+    return 0;
+}
+
+SEC("iter/bpf_map_elem")
+int dump_text(struct bpf_iter__bpf_map_elem *ctx) {
+    static const char fmt[] = "%pI4 %u\n";
+    struct honeypot_dump_record rec;
+    if (select_source(ctx, &rec)) {
+        __u64 args[2] = {(__u64)(long)&rec.src_ip, rec.count};
+        bpf_seq_printf(ctx->meta->seq, fmt, sizeof(fmt), args, sizeof(args));
+    }
+    return 0;
+}
+
+char _license[] SEC("license") = "GPL";
@@ -0,0 +1,458 @@
+// modules/security/honeypot_loader.cpp — userspace loader for honeypot.bpf.o
+// Attaches xdp_ssh_redirect through a bpf_link pinned in bpffs and pins the
+// maps next to it. Running `attach` again with a newer object reuses the
+// pinned maps and swaps the program in place with bpf_link_update(), so an
+// upgrade never detaches the interface and never drops attack_map state.
+//
+// Build: clang++ -O2 -std=c++17 honeypot_loader.cpp -lbpf -o honeypot-loader
+// Usage: honeypot-loader attach <ifname>[,<ifname>...] [honeypot.bpf.o] [--mode auto|native|tc|generic]
+//        honeypot-loader detach <ifname>[,<ifname>...]
+//        honeypot-loader status <ifname>[,<ifname>...]
+//        honeypot-loader shadow-socket
+//
+// All interfaces of one attach share a single loaded program and its maps
+// (e.g. `attach eth0,eth1,bond0`); each gets its own pinned link, and
+// `honeypot-ctl iface` sets their mode and threshold.
+//
+// The hook is chosen per interface. auto (the default) takes native XDP
+// when the driver implements it, else xdp_ssh_redirect's twin
+// tc_ssh_detect on tcx ingress, and generic XDP only when neither works;
+// honeypot-mode-bench measures the three on a host. An upgrade keeps the
+// hook the pinned link already has; detach first to change it.
+//
+// attach also installs sk_lookup_shadow on the current network namespace
+// (one pinned link shared by all interfaces); shadow-socket then registers
+// the listening socket on SHADOW_PORT so flagged sources are handed to it.
+//
+// A program attached with `ip link set ... xdp obj` must be removed first
+// (`ip link set dev <if> xdp off`); a legacy attachment blocks link creation.
+
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/ethtool.h>
+#include <linux/sockios.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "honeypot.h"
+#include "honeypot_maps.h"
+
+namespace {
+
+const char *kDefaultObject = "honeypot.bpf.o";
+
+std::string link_pin_path(const char *ifname) {
+    return std::string(HONEYPOT_LINK_PFX) + ifname;
+}
+
+int ensure_pin_root() {
+    if (mkdir(HONEYPOT_PIN_ROOT, 0700) && errno != EEXIST) {
+        int err = -errno;
+        fprintf(stderr, "[honeypot-loader] mkdir %s: %s "
+                "(is bpffs mounted on /sys/fs/bpf?)\n",
+                HONEYPOT_PIN_ROOT, strerror(errno));
+        return err;
+    }
+    return 0;
+}
+
+// Swaps prog into the link pinned at pin, or creates a link with attach(),
+// which returns its fd or -errno, and pins it when there is none yet.
+template <typename AttachFn>
+int attach_or_update(bpf_program *prog, const std::string &pin, const char *what, AttachFn attach) {
+    int err;
+    bpf_link *link = bpf_link__open(pin.c_str());
+    if (link) {
+        // Upgrade: a single bpf_link_update() replaces the program the
+        // hook points at. Packets see either the old or the new program,
+        // never neither.
+        auto t0 = std::chrono::steady_clock::now();
+        err = bpf_link__update_program(link, prog);
+        auto t1 = std::chrono::steady_clock::now();
+        if (err) {
+            fprintf(stderr, "[honeypot-loader] link update on %s: %s\n", what, strerror(-err));
+        } else {
+            auto us = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+            printf("[honeypot-loader] %s: replaced program in %lld us, maps kept\n",
+                   what, static_cast<long long>(us));
+        }
+        bpf_link__destroy(link);
+        return err;
+    }
+    int fd = attach();
+    if (fd < 0) {
+        fprintf(stderr, "[honeypot-loader] attach %s: %s\n", what, strerror(-fd));
+        return fd;
+    }
+    err = bpf_obj_pin(fd, pin.c_str()) ? -errno : 0;
+    if (err)
+        fprintf(stderr, "[honeypot-loader] pin %s: %s\n", pin.c_str(), strerror(-err));
+    else
+        printf("[honeypot-loader] %s: attached, link pinned at %s\n", what, pin.c_str());
+    close(fd);
+    return err;
+}
+
+// Driver behind ifname as ethtool reports it, for the log.
+std::string driver_name(const char *ifname) {
+    ethtool_drvinfo info{};
+    info.cmd = ETHTOOL_GDRVINFO;
+    ifreq ifr{};
+    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+    ifr.ifr_data = reinterpret_cast<char *>(&info);
+    int sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    bool ok = sock >= 0 && !ioctl(sock, SIOCETHTOOL, &ifr);
+    if (sock >= 0)
+        close(sock);
+    return ok && info.driver[0] ? info.driver : "unknown driver";
+}
+
+// Whether the link pinned at pin is an XDP link; false also without one.
+bool pinned_link_is_xdp(const std::string &pin) {
+    int fd = bpf_obj_get(pin.c_str());
+    if (fd < 0)
+        return false;
+    bpf_link_info info{};
+    __u32 len = sizeof(info);
+    bool xdp = !bpf_obj_get_info_by_fd(fd, &info, &len) && info.type == BPF_LINK_TYPE_XDP;
+    close(fd);
+    return xdp;
+}
+
+// New link for ifname in the requested mode, or in the cheapest one the
+// driver supports for "auto". Returns the link fd or -errno.
+int attach_interface(bpf_object *obj, const char *ifname, unsigned ifindex, const char *mode) {
+    const std::string driver = driver_name(ifname);
+    honeypot_mode chosen;
+    if (strcmp(mode, "auto")) {
+        int err = honeypot_parse_mode(mode, chosen);
+        if (err)
+            return err;
+        int fd = honeypot_attach_mode(obj, ifindex, chosen);
+        if (fd >= 0)
+            printf("[honeypot-loader] %s (%s): %s mode\n", ifname, driver.c_str(), mode);
+        return fd;
+    }
+    int fd = -ENOENT;
+    for (honeypot_mode m : {honeypot_mode::native, honeypot_mode::tc, honeypot_mode::generic}) {
+        fd = honeypot_attach_mode(obj, ifindex, m);
+        if (fd >= 0) {
+            printf("[honeypot-loader] %s (%s): %s mode\n", ifname, driver.c_str(), honeypot_mode_name(m));
+            break;
+        }
+        fprintf(stderr, "[honeypot-loader] %s (%s): no %s mode: %s\n",
+                ifname, driver.c_str(), honeypot_mode_name(m), strerror(-fd));
+    }
+    return fd;
+}
+
+// Loads the object once and links its program to every interface, so a
+// gateway with several uplinks runs one program instance over one set of
+// maps; the program tells the interfaces apart by ingress ifindex.
+int cmd_attach(const std::vector<std::string> &ifnames, const char *obj_path, const char *mode) {
+    std::vector<unsigned> ifindexes;
+    for (const std::string &ifname : ifnames) {
+        unsigned ifindex = if_nametoindex(ifname.c_str());
+        if (!ifindex) {
+            fprintf(stderr, "[honeypot-loader] unknown interface %s\n", ifname.c_str());
+            return -ENODEV;
+        }
+        ifindexes.push_back(ifindex);
+    }
+    int err = ensure_pin_root();
+    if (err)
+        return err;
+
+    // pin_root_path makes libbpf reuse any map already pinned by name and
+    // pin newly created ones, which is what carries state across reloads.
+    bpf_object_open_opts opts{};
+    opts.sz = sizeof(opts);
+    opts.pin_root_path = HONEYPOT_PIN_ROOT;
+
+    bpf_object *obj = bpf_object__open_file(obj_path, &opts);
+    if (!obj) {
+        fprintf(stderr, "[honeypot-loader] open %s: %s\n", obj_path, strerror(errno));
+        return -errno;
+    }
+    // honeypot_events gets one ring per possible CPU. The count is fixed
+    // for the host, so a pinned holder from an earlier load still matches.
+    int ncpus = libbpf_num_possible_cpus();
+    bpf_map *events = bpf_object__find_map_by_name(obj, HONEYPOT_EVENTS_MAP);
+    if (events && ncpus > 0)
+        bpf_map__set_max_entries(events, static_cast<__u32>(ncpus));
+
+    err = bpf_object__load(obj);
+    if (err) {
+        fprintf(stderr, "[honeypot-loader] load %s: %s (a pinned map whose "
+                "layout changed must be removed from %s first)\n",
+                obj_path, strerror(-err), HONEYPOT_PIN_ROOT);
+        bpf_object__close(obj);
+        return err;
+    }
+    if (events && ncpus > 0) {
+        // Not fatal: without rings the controller falls back to scanning.
+        int ring_err = honeypot_fill_rings(bpf_map__fd(events), static_cast<__u32>(ncpus),
+                                           HONEYPOT_EVENTS_BYTES);
+        if (ring_err)
+            fprintf(stderr, "[honeypot-loader] event rings: %s\n", strerror(-ring_err));
+    }
+
+    // An existing link is upgraded with the program for its own hook. One
+    // interface failing does not stop the others.
+    bool attached = false;
+    for (size_t i = 0; i < ifnames.size(); i++) {
+        const char *ifname = ifnames[i].c_str();
+        const std::string pin = link_pin_path(ifname);
+        bool tc = !access(pin.c_str(), F_OK) && !pinned_link_is_xdp(pin);
+        const char *prog_name = tc ? HONEYPOT_TC_PROG : HONEYPOT_PROG_NAME;
+        bpf_program *prog = bpf_object__find_program_by_name(obj, prog_name);
+        int if_err = prog ? 0 : -ENOENT;
+        if (!prog)
+            fprintf(stderr, "[honeypot-loader] %s has no program %s\n", obj_path, prog_name);
+        else
+            if_err = attach_or_update(prog, pin, ifname, [&] {
+                return attach_interface(obj, ifname, ifindexes[i], mode);
+            });
+        if (if_err && !err)
+            err = if_err;
+        attached |= !if_err;
+    }
+
+    // sk_lookup hooks the network namespace rather than an interface, so a
+    // single link steers flagged sources arriving on any enforcing one.
+    bpf_program *steer = bpf_object__find_program_by_name(obj, HONEYPOT_SK_LOOKUP_PROG);
+    if (attached && steer) {
+        int netns = open("/proc/self/ns/net", O_RDONLY | O_CLOEXEC);
+        int steer_err = attach_or_update(steer, HONEYPOT_SK_LOOKUP_LINK, "sk_lookup", [&] {
+            int fd = bpf_link_create(bpf_program__fd(steer), netns, BPF_SK_LOOKUP, nullptr);
+            return fd < 0 ? -errno : fd;
+        });
+        close(netns);
+        if (steer_err && !err)
+            err = steer_err;
+    }
+
+    // The pinned links keep the programs alive and the pinned maps keep
+    // the state; our own fds can go.
+    bpf_object__close(obj);
+    return err;
+}
+
+int cmd_detach(const char *ifname) {
+    const std::string pin = link_pin_path(ifname);
+    bpf_link *link = bpf_link__open(pin.c_str());
+    if (!link) {
+        fprintf(stderr, "[honeypot-loader] no link pinned at %s\n", pin.c_str());
+        return -ENOENT;
+    }
+    int err = bpf_link__unpin(link);
+    if (!err)
+        err = bpf_link__detach(link);
+    bpf_link__destroy(link);
+    if (err)
+        fprintf(stderr, "[honeypot-loader] detach %s: %s\n", ifname, strerror(-err));
+    else
+        printf("[honeypot-loader] %s: detached (maps stay pinned in %s)\n",
+               ifname, HONEYPOT_PIN_ROOT);
+    return err;
+}
+
+// Hook of a pinned interface link, for status.
+const char *link_mode(const bpf_link_info &info) {
+    if (info.type != BPF_LINK_TYPE_XDP)
+        return "tc";
+    bpf_xdp_query_opts q{};
+    q.sz = sizeof(q);
+    if (bpf_xdp_query(static_cast<int>(info.xdp.ifindex), 0, &q))
+        return "xdp";
+    return q.attach_mode == XDP_ATTACHED_SKB ? "generic" : "native";
+}
+
+int cmd_status(const char *ifname) {
+    const std::string pin = link_pin_path(ifname);
+    bpf_link *link = bpf_link__open(pin.c_str());
+    if (!link) {
+        printf("[honeypot-loader] %s: not attached\n", ifname);
+        return -ENOENT;
+    }
+    bpf_link_info info{};
+    __u32 len = sizeof(info);
+    int err = bpf_obj_get_info_by_fd(bpf_link__fd(link), &info, &len);
+    if (err)
+        fprintf(stderr, "[honeypot-loader] link info: %s\n", strerror(errno));
+    else
+        printf("[honeypot-loader] %s: link id %u, prog id %u, %s mode\n",
+               ifname, info.id, info.prog_id, link_mode(info));
+    bpf_link__destroy(link);
+    return err;
+}
+
+// Inode of the IPv4 TCP socket listening on port, from /proc/net/tcp.
+unsigned long listener_inode(unsigned port) {
+    FILE *f = fopen("/proc/net/tcp", "re");
+    if (!f)
+        return 0;
+    char line[512];
+    unsigned long found = 0;
+    while (!found && fgets(line, sizeof(line), f)) {
+        unsigned lport = 0, state = 0;
+        unsigned long inode = 0;
+        if (sscanf(line, " %*u: %*x:%x %*x:%*x %x %*x:%*x %*x:%*x %*x %*u %*u %lu",
+                   &lport, &state, &inode) == 3 &&
+            lport == port && state == 0x0A /* TCP_LISTEN */)
+            found = inode;
+    }
+    fclose(f);
+    return found;
+}
+
+// Finds a process holding socket:[inode] and the fd number it uses.
+bool find_socket_owner(unsigned long inode, pid_t &pid, int &fd) {
+    const std::string want = "socket:[" + std::to_string(inode) + "]";
+    DIR *proc = opendir("/proc");
+    if (!proc)
+        return false;
+    bool found = false;
+    while (dirent *p = readdir(proc)) {
+        if (found || p->d_name[0] < '0' || p->d_name[0] > '9')
+            continue;
+        const std::string fds = std::string("/proc/") + p->d_name + "/fd";
+        DIR *dir = opendir(fds.c_str());
+        if (!dir)
+            continue;
+        while (dirent *e = readdir(dir)) {
+            char target[64];
+            const std::string path = fds + "/" + e->d_name;
+            ssize_t n = readlink(path.c_str(), target, sizeof(target) - 1);
+            if (n > 0 && want.compare(0, std::string::npos, target, n) == 0) {
+                pid = static_cast<pid_t>(atoi(p->d_name));
+                fd = atoi(e->d_name);
+                found = true;
+                break;
+            }
+        }
+        closedir(dir);
+    }
+    closedir(proc);
+    return found;
+}
+
+// Registers the shadow shell's listening socket in shadow_sock. The socket
+// is duplicated out of the running honeypot with pidfd_getfd(), so the
+// Python side needs no changes. Re-run after the honeypot restarts: the
+// kernel drops a closed socket from the sockmap by itself.
+int cmd_shadow_socket() {
+    unsigned long inode = listener_inode(SHADOW_PORT);
+    pid_t pid;
+    int remote_fd;
+    if (!inode || !find_socket_owner(inode, pid, remote_fd)) {
+        fprintf(stderr, "[honeypot-loader] nothing listens on tcp/%d\n", SHADOW_PORT);
+        return -ENOENT;
+    }
+    int pidfd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+    int sock = pidfd < 0 ? -1 : static_cast<int>(syscall(SYS_pidfd_getfd, pidfd, remote_fd, 0));
+    if (sock < 0) {
+        int err = -errno;
+        fprintf(stderr, "[honeypot-loader] take socket from pid %d: %s\n", pid, strerror(errno));
+        if (pidfd >= 0)
+            close(pidfd);
+        return err;
+    }
+    close(pidfd);
+
+    int err = 0;
+    int map = bpf_obj_get(HONEYPOT_SHADOW_SOCK_PIN);
+    __u32 zero = 0;
+    __u64 value = static_cast<__u64>(sock);
+    if (map < 0 || bpf_map_update_elem(map, &zero, &value, BPF_ANY)) {
+        err = -errno;
+        fprintf(stderr, "[honeypot-loader] %s: %s\n", HONEYPOT_SHADOW_SOCK_PIN, strerror(errno));
+    } else {
+        printf("[honeypot-loader] shadow shell socket of pid %d registered for sk_lookup\n", pid);
+    }
+    if (map >= 0)
+        close(map);
+    close(sock);
+    return err;
+}
+
+std::vector<std::string> split_ifnames(const char *list) {
+    std::vector<std::string> out;
+    std::string cur;
+    for (const char *p = list;; p++) {
+        if (*p == ',' || !*p) {
+            if (!cur.empty())
+                out.push_back(cur);
+            cur.clear();
+            if (!*p)
+                return out;
+        } else {
+            cur += *p;
+        }
+    }
+}
+
+void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s attach <ifname>[,<ifname>...] [%s] [--mode auto|native|tc|generic]\n"
+            "       %s detach <ifname>[,<ifname>...]\n"
+            "       %s status <ifname>[,<ifname>...]\n"
+            "       %s shadow-socket\n",
+            argv0, kDefaultObject, argv0, argv0, argv0);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc == 2 && !strcmp(argv[1], "shadow-socket"))
+        return cmd_shadow_socket() ? 1 : 0;
+    if (argc < 3) {
+        usage(argv[0]);
+        return 2;
+    }
+    const std::string cmd = argv[1];
+    const std::vector<std::string> ifnames = split_ifnames(argv[2]);
+    if (ifnames.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+    int err = 0;
+    if (cmd == "attach") {
+        const char *obj_path = kDefaultObject, *mode = "auto";
+        for (int i = 3; i < argc; i++) {
+            if (!strcmp(argv[i], "--mode") && i + 1 < argc) {
+                mode = argv[++i];
+            } else if (argv[i][0] != '-') {
+                obj_path = argv[i];
+            } else {
+                usage(argv[0]);
+                return 2;
+            }
+        }
+        err = cmd_attach(ifnames, obj_path, mode);
+    } else if (cmd == "detach" || cmd == "status") {
+        for (const std::string &ifname : ifnames) {
+            int if_err = cmd == "detach" ? cmd_detach(ifname.c_str()) : cmd_status(ifname.c_str());
+            if (if_err && !err)
+                err = if_err;
+        }
+    } else {
+        usage(argv[0]);
+        return 2;
+    }
+    return err ? 1 : 0;
+}
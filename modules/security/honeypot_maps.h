@@ -0,0 +1,238 @@
+// modules/security/honeypot_maps.h — userspace access to the pinned honeypot
+// maps, shared by the honeypot-* tools. Header-only so each tool still
+// builds from a single translation unit.
+
+#ifndef OMNICLAW_HONEYPOT_MAPS_H
+#define OMNICLAW_HONEYPOT_MAPS_H
+
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+#include <linux/if_link.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "honeypot.h"
+
+// Entries per BPF_MAP_{LOOKUP,UPDATE}_BATCH syscall.
+constexpr uint32_t kHoneypotBatch = 65536;
+
+// Current attack_map slot from honeypot_cfg, or -errno.
+inline int honeypot_current_epoch(int cfg_fd) {
+    __u32 zero = 0;
+    honeypot_config cfg{};
+    if (bpf_map_lookup_elem(cfg_fd, &zero, &cfg))
+        return -errno;
+    return static_cast<int>(cfg.epoch % HONEYPOT_EPOCHS);
+}
+
+// Writes one field of honeypot_cfg (offsetof(honeypot_config, ...)). The
+// map is mmapable and each writer stores only its own field, so a rotation
+// and a threshold change cannot undo each other the way read-modify-writes
+// of the whole value would.
+inline int honeypot_cfg_store(int cfg_fd, size_t offset, __u32 value) {
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    void *p = mmap(nullptr, page, PROT_READ | PROT_WRITE, MAP_SHARED, cfg_fd, 0);
+    if (p == MAP_FAILED)
+        return -errno;
+    __atomic_store_n(reinterpret_cast<__u32 *>(static_cast<char *>(p) + offset), value, __ATOMIC_RELEASE);
+    munmap(p, page);
+    return 0;
+}
+
+inline __u32 honeypot_prev_epoch(__u32 epoch) {
+    return (epoch + HONEYPOT_EPOCHS - 1) % HONEYPOT_EPOCHS;
+}
+
+// Resolves the counter table currently installed in an attack_map slot.
+// Returns a new fd, or -errno (-ENOENT for an empty slot).
+inline int honeypot_open_table(int holder_fd, __u32 slot) {
+    __u32 id = 0;
+    if (bpf_map_lookup_elem(holder_fd, &slot, &id))
+        return -errno;
+    int fd = bpf_map_get_fd_by_id(id);
+    return fd < 0 ? -errno : fd;
+}
+
+// Appends every {src_ip, count} pair of a counter table to out, one
+// BPF_MAP_LOOKUP_BATCH per kHoneypotBatch entries. Rec must be
+// aggregate-initialisable from two uint32_t.
+template <typename Rec>
+int honeypot_dump_table(int table_fd, std::vector<Rec> &out) {
+    std::vector<uint32_t> keys(kHoneypotBatch), vals(kHoneypotBatch);
+    uint32_t token = 0;
+    bool first = true;
+    bpf_map_batch_opts opts{};
+    opts.sz = sizeof(opts);
+
+    for (;;) {
+        uint32_t n = kHoneypotBatch;
+        int err = bpf_map_lookup_batch(table_fd, first ? nullptr : &token, &token,
+                                       keys.data(), vals.data(), &n, &opts);
+        first = false;
+        if (err && errno != ENOENT)
+            return -errno;
+        for (uint32_t i = 0; i < n; i++)
+            out.push_back(Rec{keys[i], vals[i]});
+        if (err)              // ENOENT: walked past the last bucket
+            return 0;
+    }
+}
+
+// Dumps the sliding window the program sees: the current epoch's counts
+// plus the previous epoch's, summed per source.
+template <typename Rec>
+int honeypot_dump_window(int holder_fd, int cfg_fd, std::vector<Rec> &out) {
+    int epoch = honeypot_current_epoch(cfg_fd);
+    if (epoch < 0)
+        return epoch;
+    std::vector<Rec> recs;
+    const __u32 slots[2] = {static_cast<__u32>(epoch), honeypot_prev_epoch(epoch)};
+    for (__u32 slot : slots) {
+        int fd = honeypot_open_table(holder_fd, slot);
+        if (fd == -ENOENT)
+            continue;
+        if (fd < 0)
+            return fd;
+        int err = honeypot_dump_table(fd, recs);
+        close(fd);
+        if (err)
+            return err;
+    }
+    std::unordered_map<uint32_t, size_t> index;
+    index.reserve(recs.size());
+    for (const Rec &r : recs) {
+        auto it = index.emplace(r.src_ip, out.size());
+        if (it.second)
+            out.push_back(r);
+        else
+            out[it.first->second].count += r.count;
+    }
+    return 0;
+}
+
+// Gives every empty slot of an array-of-ringbufs holder (honeypot_events)
+// its own ring of the given size. Slots already filled, e.g. by an earlier
+// load, keep their ring and whatever a consumer has not read yet.
+inline int honeypot_fill_rings(int holder_fd, __u32 slots, __u32 bytes) {
+    for (__u32 slot = 0; slot < slots; slot++) {
+        __u32 id;
+        if (!bpf_map_lookup_elem(holder_fd, &slot, &id))
+            continue;
+        int ring = bpf_map_create(BPF_MAP_TYPE_RINGBUF, "event_ring", 0, 0, bytes, nullptr);
+        if (ring < 0)
+            return -errno;
+        __u32 value = static_cast<__u32>(ring);
+        int err = bpf_map_update_elem(holder_fd, &slot, &value, BPF_ANY) ? -errno : 0;
+        close(ring);
+        if (err)
+            return err;
+    }
+    return 0;
+}
+
+// Subscribes fn to every ring of an array-of-ringbufs holder. libbpf keeps
+// them all in the one epoll set of the returned ring_buffer, so a single
+// ring_buffer__poll() drains whichever CPUs have data. nullptr with errno
+// set on failure; fds of rings added before the failure are not reclaimed.
+inline ring_buffer *honeypot_open_rings(int holder_fd, ring_buffer_sample_fn fn, void *ctx) {
+    bpf_map_info info{};
+    __u32 len = sizeof(info);
+    if (bpf_obj_get_info_by_fd(holder_fd, &info, &len))
+        return nullptr;
+    ring_buffer *rb = nullptr;
+    for (__u32 slot = 0; slot < info.max_entries; slot++) {
+        int ring = honeypot_open_table(holder_fd, slot);
+        if (ring == -ENOENT)
+            continue;
+        int err = ring < 0 ? ring : 0;
+        if (!err && !rb) {
+            rb = ring_buffer__new(ring, fn, ctx, nullptr);
+            err = rb ? 0 : -errno;
+        } else if (!err) {
+            err = ring_buffer__add(rb, ring, fn, ctx);
+        }
+        // On success the fd stays open for the life of rb, which polls it
+        // but does not own it.
+        if (err) {
+            if (ring >= 0)
+                close(ring);
+            ring_buffer__free(rb);
+            errno = -err;
+            return nullptr;
+        }
+    }
+    if (!rb)
+        errno = ENOENT;
+    return rb;
+}
+
+// The whole of s as a number in [min, max], for the tools' arguments.
+// Signs, trailing characters and overflow all fail, so a typo is a usage
+// error instead of a silent 0 or, for the options where negative means
+// "keep", a silent no-op.
+inline bool honeypot_parse_num(const char *s, int base, unsigned long min, unsigned long max,
+                               unsigned long &out) {
+    if (!isxdigit(static_cast<unsigned char>(*s)))
+        return false;
+    char *end;
+    errno = 0;
+    unsigned long v = strtoul(s, &end, base);
+    if (*end || errno || v < min || v > max)
+        return false;
+    out = v;
+    return true;
+}
+
+// Hooks the detector can run on, cheapest first where the driver allows:
+// native XDP runs before any skb exists, TC on the skb the stack built
+// anyway, generic XDP on an skb plus the cost of emulating XDP on it.
+enum class honeypot_mode { native, tc, generic };
+
+inline const char *honeypot_mode_name(honeypot_mode mode) {
+    switch (mode) {
+    case honeypot_mode::native:  return "native";
+    case honeypot_mode::tc:      return "tc";
+    case honeypot_mode::generic: return "generic";
+    }
+    return "?";
+}
+
+inline int honeypot_parse_mode(const char *name, honeypot_mode &mode) {
+    for (honeypot_mode m : {honeypot_mode::native, honeypot_mode::tc, honeypot_mode::generic}) {
+        if (!strcmp(name, honeypot_mode_name(m))) {
+            mode = m;
+            return 0;
+        }
+    }
+    return -EINVAL;
+}
+
+// Links the detector of a loaded honeypot.bpf.o to ifindex in one mode:
+// xdp_ssh_redirect with XDP_FLAGS_DRV_MODE or XDP_FLAGS_SKB_MODE, or
+// tc_ssh_detect on tcx ingress (Linux 6.6). Native fails with -EOPNOTSUPP
+// when the driver has no XDP support of its own. Returns the link fd,
+// which detaches on close unless pinned, or -errno.
+inline int honeypot_attach_mode(bpf_object *obj, unsigned ifindex, honeypot_mode mode) {
+    bool tc = mode == honeypot_mode::tc;
+    bpf_program *prog = bpf_object__find_program_by_name(obj, tc ? HONEYPOT_TC_PROG : HONEYPOT_PROG_NAME);
+    if (!prog)
+        return -ENOENT;
+    bpf_link_create_opts opts{};
+    opts.sz = sizeof(opts);
+    if (!tc)
+        opts.flags = mode == honeypot_mode::native ? XDP_FLAGS_DRV_MODE : XDP_FLAGS_SKB_MODE;
+    int fd = bpf_link_create(bpf_program__fd(prog), static_cast<int>(ifindex),
+                             tc ? BPF_TCX_INGRESS : BPF_XDP, &opts);
+    return fd < 0 ? -errno : fd;
+}
+
+#endif // OMNICLAW_HONEYPOT_MAPS_H
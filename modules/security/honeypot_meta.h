@@ -0,0 +1,57 @@
+// modules/security/honeypot_meta.h — detector outcome in the XDP metadata area
+// xdp_ssh_redirect has already looked the source up in every map by the
+// time it passes a frame. It stores the outcome (struct honeypot_meta)
+// with bpf_xdp_adjust_meta right in front of the packet data, where the
+// kernel keeps it when it builds the skb, so a TC program further on reads
+// the verdict and score with two pointer compares instead of a second round
+// of hash lookups. Each frame then pays for the offender lookup once.
+//
+// Reach: later XDP programs and TC (cls_bpf, tcx) programs on the same
+// interface. Socket-level hooks (sk_lookup, cgroup/skb, socket filters)
+// cannot see the metadata area; a TC program that wants to hand the
+// verdict further copies it into skb->mark. Drivers without metadata
+// support make the store fail and consumers see no metadata: they must
+// always keep their map lookup as the fallback. So must they when an XDP
+// program after this one prepends metadata of its own.
+//
+// BPF only; include after bpf/bpf_helpers.h.
+
+#ifndef OMNICLAW_HONEYPOT_META_H
+#define OMNICLAW_HONEYPOT_META_H
+
+#include <linux/bpf.h>
+
+#include "honeypot.h"
+
+// Prepends m to the frame. Nonzero when the driver has no metadata room.
+static __always_inline int honeypot_meta_store(struct xdp_md *ctx, const struct honeypot_meta *m) {
+    if (bpf_xdp_adjust_meta(ctx, -(int)sizeof(*m)))
+        return -1;
+    void *data = (void *)(long)ctx->data;
+    struct honeypot_meta *dst = (void *)(long)ctx->data_meta;
+    if ((void *)(dst + 1) > data)
+        return -1;
+    *dst = *m;
+    return 0;
+}
+
+static __always_inline const struct honeypot_meta *honeypot_meta_at(void *meta, void *data) {
+    const struct honeypot_meta *m = meta;
+    if ((void *)(m + 1) > data || m->magic != HONEYPOT_META_MAGIC)
+        return 0;
+    return m;
+}
+
+// What xdp_ssh_redirect decided on this frame; NULL when it did not see
+// the frame or the frame is not SSH.
+static __always_inline const struct honeypot_meta *honeypot_meta_xdp(struct xdp_md *ctx) {
+    return honeypot_meta_at((void *)(long)ctx->data_meta, (void *)(long)ctx->data);
+}
+
+// The same from a TC program. Read it before bpf_skb_pull_data or any other
+// helper that invalidates packet pointers.
+static __always_inline const struct honeypot_meta *honeypot_meta_skb(struct __sk_buff *skb) {
+    return honeypot_meta_at((void *)(long)skb->data_meta, (void *)(long)skb->data);
+}
+
+#endif // OMNICLAW_HONEYPOT_META_H
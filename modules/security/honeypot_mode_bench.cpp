@@ -0,0 +1,273 @@
+// modules/security/honeypot_mode_bench.cpp — native XDP vs TC vs generic XDP
+// Attaches the detector of honeypot.bpf.o to one end of a veth pair in each
+// mode honeypot-loader can pick, blasts SSH SYNs into the other end from a
+// packet socket and prints what each mode costs. The sender is pinned to
+// one CPU and veth delivers on the sending CPU, so that CPU's busy time
+// (user, system, irq and softirq from /proc/stat) covers the whole receive
+// path; "cpu ns/pkt" is the number to compare, "prog ns/pkt" the share of
+// it spent inside the program (BPF_STATS_RUN_TIME). The "none" row is the
+// same traffic with nothing attached.
+//
+// The object's maps are created fresh and never pinned, so a benchmark
+// leaves a running honeypot alone. Create the pair first:
+//   ip link add hpb0 type veth peer name hpb1 && ip link set hpb0 up && ip link set hpb1 up
+//
+// Build: clang++ -O2 -std=c++17 honeypot_mode_bench.cpp -lbpf -o honeypot-mode-bench
+// Usage: honeypot-mode-bench <ifname> <peer> [honeypot.bpf.o] [--packets <n>] [--sources <n>]
+//        (as root; the detector goes on <ifname>, traffic enters from <peer>)
+
+#include <arpa/inet.h>
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/ip.h>
+#include <linux/tcp.h>
+#include <net/if.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "honeypot.h"
+#include "honeypot_maps.h"
+
+namespace {
+
+const char *kDefaultObject = "honeypot.bpf.o";
+constexpr unsigned kBatch = 64;
+constexpr size_t kFrameLen = sizeof(ethhdr) + sizeof(iphdr) + sizeof(tcphdr);
+
+struct result {
+    double   mpps;
+    double   cpu_ns;        // per packet, busy time of the sending CPU
+    double   prog_ns;       // per program run, 0 with nothing attached
+    uint64_t runs;
+};
+
+// Busy jiffies of one CPU: everything in /proc/stat but idle and iowait.
+uint64_t cpu_busy_ticks(int cpu) {
+    FILE *f = fopen("/proc/stat", "re");
+    if (!f)
+        return 0;
+    char want[16], line[512];
+    snprintf(want, sizeof(want), "cpu%d ", cpu);
+    uint64_t busy = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, want, strlen(want)))
+            continue;
+        unsigned long long v[8] = {};
+        sscanf(line + strlen(want), "%llu %llu %llu %llu %llu %llu %llu %llu",
+               &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]);
+        busy = v[0] + v[1] + v[2] + v[5] + v[6] + v[7];
+        break;
+    }
+    fclose(f);
+    return busy;
+}
+
+void prog_stats(int prog_fd, uint64_t &runs, uint64_t &ns) {
+    bpf_prog_info info{};
+    __u32 len = sizeof(info);
+    runs = ns = 0;
+    if (prog_fd >= 0 && !bpf_obj_get_info_by_fd(prog_fd, &info, &len)) {
+        runs = info.run_cnt;
+        ns = info.run_time_ns;
+    }
+}
+
+// One SYN to port 22 per source, sources counting up from 198.18.0.1
+// (RFC 2544 benchmark space) towards dst, the MAC of the detector's end.
+std::vector<unsigned char> build_frames(const unsigned char *dst, unsigned sources) {
+    std::vector<unsigned char> frames(kFrameLen * sources);
+    for (unsigned i = 0; i < sources; i++) {
+        unsigned char *p = frames.data() + kFrameLen * i;
+        auto *eth = reinterpret_cast<ethhdr *>(p);
+        memcpy(eth->h_dest, dst, ETH_ALEN);
+        eth->h_source[0] = 0x02;
+        eth->h_proto = htons(ETH_P_IP);
+        auto *ip = reinterpret_cast<iphdr *>(eth + 1);
+        ip->version = 4;
+        ip->ihl = 5;
+        ip->tot_len = htons(sizeof(iphdr) + sizeof(tcphdr));
+        ip->ttl = 64;
+        ip->protocol = IPPROTO_TCP;
+        ip->saddr = htonl(0xc6120001u + i);
+        ip->daddr = htonl(0xc613ffffu);
+        auto *tcp = reinterpret_cast<tcphdr *>(ip + 1);
+        tcp->source = htons(static_cast<uint16_t>(40000 + i % 20000));
+        tcp->dest = htons(HONEYPOT_SSH_PORT);
+        tcp->doff = 5;
+        tcp->syn = 1;
+        tcp->window = htons(64240);
+    }
+    return frames;
+}
+
+result run(int sock, const std::vector<unsigned char> &frames, unsigned sources,
+           uint64_t packets, int cpu, int prog_fd) {
+    std::vector<iovec> iov(kBatch);
+    std::vector<mmsghdr> msgs(kBatch);
+    uint64_t runs0, ns0, runs1, ns1;
+    prog_stats(prog_fd, runs0, ns0);
+    uint64_t busy0 = cpu_busy_ticks(cpu);
+    auto t0 = std::chrono::steady_clock::now();
+
+    uint64_t sent = 0;
+    unsigned next = 0;
+    while (sent < packets) {
+        unsigned n = static_cast<unsigned>(std::min<uint64_t>(kBatch, packets - sent));
+        for (unsigned i = 0; i < n; i++) {
+            iov[i].iov_base = const_cast<unsigned char *>(frames.data() + kFrameLen * next);
+            iov[i].iov_len = kFrameLen;
+            msgs[i] = mmsghdr{};
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            next = (next + 1) % sources;
+        }
+        int done = sendmmsg(sock, msgs.data(), n, 0);
+        if (done < 0) {
+            if (errno == ENOBUFS || errno == EAGAIN)
+                continue;
+            fprintf(stderr, "[honeypot-mode-bench] sendmmsg: %s\n", strerror(errno));
+            break;
+        }
+        sent += static_cast<unsigned>(done);
+    }
+
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    uint64_t busy = cpu_busy_ticks(cpu) - busy0;
+    prog_stats(prog_fd, runs1, ns1);
+    double tick_ns = 1e9 / static_cast<double>(sysconf(_SC_CLK_TCK));
+    result r{};
+    r.mpps = sent / secs / 1e6;
+    r.cpu_ns = sent ? busy * tick_ns / sent : 0;
+    r.runs = runs1 - runs0;
+    r.prog_ns = r.runs ? static_cast<double>(ns1 - ns0) / r.runs : 0;
+    return r;
+}
+
+void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s <ifname> <peer> [%s] [--packets <n>] [--sources <n>]\n",
+            argv0, kDefaultObject);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const char *ifname = nullptr, *peer = nullptr, *obj_path = kDefaultObject;
+    uint64_t packets = 10000000;
+    unsigned sources = 1024;
+    for (int i = 1; i < argc; i++) {
+        unsigned long v;
+        // Sources are addresses of 198.18.0.0/15.
+        if (!strcmp(argv[i], "--packets") && i + 1 < argc &&
+            honeypot_parse_num(argv[i + 1], 10, 1, ULONG_MAX, v)) {
+            packets = v;
+            i++;
+        } else if (!strcmp(argv[i], "--sources") && i + 1 < argc &&
+                   honeypot_parse_num(argv[i + 1], 10, 1, 131070, v)) {
+            sources = static_cast<unsigned>(v);
+            i++;
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 2;
+        } else if (!ifname) {
+            ifname = argv[i];
+        } else if (!peer) {
+            peer = argv[i];
+        } else {
+            obj_path = argv[i];
+        }
+    }
+    unsigned ifindex = ifname ? if_nametoindex(ifname) : 0;
+    unsigned peer_index = peer ? if_nametoindex(peer) : 0;
+    if (!ifindex || !peer_index || !sources || !packets) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // Sender on one CPU; veth runs the receive side in its softirq.
+    int cpu = sched_getcpu();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+    int sock = socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC, 0);
+    ifreq ifr{};
+    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+    if (sock < 0 || ioctl(sock, SIOCGIFHWADDR, &ifr)) {
+        fprintf(stderr, "[honeypot-mode-bench] packet socket on %s: %s\n", peer, strerror(errno));
+        return 1;
+    }
+    sockaddr_ll addr{};
+    addr.sll_family = AF_PACKET;
+    addr.sll_ifindex = static_cast<int>(peer_index);
+    if (bind(sock, reinterpret_cast<sockaddr *>(&addr), sizeof(addr))) {
+        fprintf(stderr, "[honeypot-mode-bench] bind %s: %s\n", peer, strerror(errno));
+        return 1;
+    }
+    std::vector<unsigned char> frames =
+        build_frames(reinterpret_cast<unsigned char *>(ifr.ifr_hwaddr.sa_data), sources);
+
+    bpf_object *obj = bpf_object__open_file(obj_path, nullptr);
+    if (!obj) {
+        fprintf(stderr, "[honeypot-mode-bench] open %s: %s\n", obj_path, strerror(errno));
+        return 1;
+    }
+    // Private maps: no pin path means libbpf neither reuses nor pins them.
+    bpf_map *map;
+    bpf_object__for_each_map(map, obj)
+        bpf_map__set_pin_path(map, nullptr);
+    int ncpus = libbpf_num_possible_cpus();
+    bpf_map *events = bpf_object__find_map_by_name(obj, HONEYPOT_EVENTS_MAP);
+    if (events)
+        bpf_map__set_max_entries(events, static_cast<__u32>(ncpus));
+    int err = bpf_object__load(obj);
+    if (!err && events)
+        err = honeypot_fill_rings(bpf_map__fd(events), static_cast<__u32>(ncpus), HONEYPOT_EVENTS_BYTES);
+    if (err) {
+        fprintf(stderr, "[honeypot-mode-bench] load %s: %s\n", obj_path, strerror(-err));
+        bpf_object__close(obj);
+        return 1;
+    }
+    int stats_fd = bpf_enable_stats(BPF_STATS_RUN_TIME);
+    if (stats_fd < 0)
+        fprintf(stderr, "[honeypot-mode-bench] run-time stats: %s, prog ns/pkt unavailable\n",
+                strerror(errno));
+
+    printf("%-8s %10s %12s %12s %12s\n", "mode", "Mpps", "cpu ns/pkt", "prog ns/pkt", "prog runs");
+    result none = run(sock, frames, sources, packets, cpu, -1);
+    printf("%-8s %10.2f %12.1f %12s %12s\n", "none", none.mpps, none.cpu_ns, "-", "-");
+    for (honeypot_mode mode : {honeypot_mode::native, honeypot_mode::tc, honeypot_mode::generic}) {
+        int link = honeypot_attach_mode(obj, ifindex, mode);
+        if (link < 0) {
+            printf("%-8s %10s   (%s)\n", honeypot_mode_name(mode), "n/a", strerror(-link));
+            continue;
+        }
+        const char *prog_name = mode == honeypot_mode::tc ? HONEYPOT_TC_PROG : HONEYPOT_PROG_NAME;
+        int prog_fd = bpf_program__fd(bpf_object__find_program_by_name(obj, prog_name));
+        result r = run(sock, frames, sources, packets, cpu, prog_fd);
+        close(link);        // unpinned: closing the fd detaches
+        printf("%-8s %10.2f %12.1f %12.1f %12llu\n", honeypot_mode_name(mode), r.mpps, r.cpu_ns,
+               r.prog_ns, static_cast<unsigned long long>(r.runs));
+    }
+
+    if (stats_fd >= 0)
+        close(stats_fd);
+    bpf_object__close(obj);
+    close(sock);
+    return 0;
+}
@@ -0,0 +1,137 @@
+// modules/security/honeypot_py.cpp — Python bindings for honeypot_controller.h
+// Gives Python services (iptables_helper.py and friends) the pinned
+// honeypot maps at syscall cost: a lookup is two bpf() calls instead of a
+// bpftool fork and a JSON parse. Every call drops the GIL while it is in
+// the kernel, and dumps come back through the buffer protocol, so
+// numpy.asarray() wraps the rows without copying them. Errors surface as
+// OSError with the errno the kernel returned.
+//
+// Build: c++ -O2 -std=c++17 -shared -fPIC $(python3 -m pybind11 --includes) honeypot_py.cpp \
+//            -lbpf -o omniclaw_honeypot$(python3-config --extension-suffix)
+// Usage: import omniclaw_honeypot as hp
+//        c = hp.Controller()                  # needs the pins of honeypot-loader
+//        c.lookup("203.0.113.7")              # attempts in the current window
+//        rows = numpy.asarray(c.offenders())  # (n, 2) uint32: src_ip, count
+//        c.threshold = 10
+//        c.allow("198.51.100.4")
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include <arpa/inet.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "honeypot_controller.h"
+
+namespace py = pybind11;
+
+namespace {
+
+// Raises OSError for a -errno result. Needs the GIL.
+void check(int err) {
+    if (err) {
+        errno = -err;
+        PyErr_SetFromErrno(PyExc_OSError);
+        throw py::error_already_set();
+    }
+}
+
+uint32_t parse_ip(const std::string &ip) {
+    in_addr addr;
+    if (inet_pton(AF_INET, ip.c_str(), &addr) != 1)
+        throw py::value_error("not an IPv4 address: " + ip);
+    return addr.s_addr;
+}
+
+std::string format_ip(uint32_t src) {
+    char buf[INET_ADDRSTRLEN];
+    in_addr addr{src};
+    inet_ntop(AF_INET, &addr, buf, sizeof(buf));
+    return buf;
+}
+
+template <typename Fn>
+int without_gil(Fn &&fn) {
+    py::gil_scoped_release release;
+    return fn();
+}
+
+// Rows of a dump: uint32 pairs of src_ip (network order, as on the wire)
+// and window count.
+struct offender_rows {
+    std::vector<honeypot_controller::offender> rows;
+};
+
+std::unique_ptr<offender_rows> dump(honeypot_controller &c, uint32_t min_count) {
+    auto out = std::make_unique<offender_rows>();
+    check(without_gil([&] { return c.dump(min_count, out->rows); }));
+    return out;
+}
+
+uint32_t threshold(honeypot_controller &c) {
+    uint32_t value = 0;
+    check(without_gil([&] { return c.threshold(value); }));
+    return value;
+}
+
+} // namespace
+
+PYBIND11_MODULE(omniclaw_honeypot, m) {
+    m.doc() = "Direct access to the pinned OmniClaw honeypot maps";
+
+    py::class_<offender_rows>(m, "OffenderRows", py::buffer_protocol())
+        .def_buffer([](offender_rows &r) {
+            return py::buffer_info(
+                r.rows.data(), sizeof(uint32_t), py::format_descriptor<uint32_t>::format(), 2,
+                {static_cast<py::ssize_t>(r.rows.size()), py::ssize_t{2}},
+                {static_cast<py::ssize_t>(sizeof(honeypot_controller::offender)),
+                 static_cast<py::ssize_t>(sizeof(uint32_t))});
+        })
+        .def("__len__", [](const offender_rows &r) { return r.rows.size(); })
+        .def("items", [](const offender_rows &r) {
+            std::vector<std::pair<std::string, uint32_t>> out;
+            out.reserve(r.rows.size());
+            for (const auto &o : r.rows)
+                out.emplace_back(format_ip(o.src_ip), o.count);
+            return out;
+        }, "List of (dotted ip, count) tuples.");
+
+    py::class_<honeypot_controller>(m, "Controller")
+        .def(py::init([] {
+            auto c = std::make_unique<honeypot_controller>();
+            check(c->open());
+            return c;
+        }))
+        .def("lookup", [](honeypot_controller &c, const std::string &ip) {
+            uint32_t src = parse_ip(ip), count = 0;
+            check(without_gil([&] { return c.lookup(src, count); }));
+            return count;
+        }, py::arg("ip"), "Attempts by ip in the current window, 0 if unknown.")
+        .def("dump", &dump, py::arg("min_count") = 0,
+             "Every source with more than min_count attempts in the window.")
+        .def("offenders", [](honeypot_controller &c) { return dump(c, threshold(c)); },
+             "Every source over the threshold in force.")
+        .def_property("threshold", &threshold, [](honeypot_controller &c, uint32_t value) {
+            check(without_gil([&] { return c.set_threshold(value); }));
+        }, "Attempts per window before a source is flagged; set 0 for the default.")
+        .def("allow", [](honeypot_controller &c, const std::string &ip) {
+            uint32_t src = parse_ip(ip);
+            check(without_gil([&] { return c.allow(src); }));
+        }, py::arg("ip"), "Pin ip in the allowlist and lift any verdict on it.")
+        .def("disallow", [](honeypot_controller &c, const std::string &ip) {
+            uint32_t src = parse_ip(ip);
+            check(without_gil([&] { return c.disallow(src); }));
+        }, py::arg("ip"))
+        .def("allowed", [](honeypot_controller &c, const std::string &ip) {
+            uint32_t src = parse_ip(ip);
+            bool yes = false;
+            check(without_gil([&] { return c.allowed(src, yes); }));
+            return yes;
+        }, py::arg("ip"));
+}
@@ -0,0 +1,411 @@
+// modules/security/honeypot_sim.cpp — replay a capture through the detector
+// Compiles honeypot_core.h natively and feeds it the frames of a pcap file,
+// so thresholds and table sizes can be tuned against days of recorded
+// traffic instead of on a live interface. The decision code is the one in
+// honeypot.bpf.o; only the maps differ: here they are flat open-addressing
+// tables in process memory, with epoch rotation driven by the packet
+// timestamps the way honeypot-ctl rotate drives it on a live host. SSH
+// connections are followed as the kernel follows them, so attempts are
+// counted the same way: one per SYN and one per further authentication
+// attempt estimated inside a connection.
+//
+// Build: clang++ -O2 -std=c++17 honeypot_sim.cpp -o honeypot-sim
+// Usage: honeypot-sim <capture.pcap> [--threshold <n>] [--rotate <seconds>]
+//                     [--allowlist <file>] [--intel <file>] [--verdicts <out>]
+//                     [--baseline <syns-per-second>] [--no-guard]
+//
+// --allowlist and --intel take one IPv4 address per line. --verdicts writes
+// one "a.b.c.d count seconds" line per flagged source, in flagging order.
+// Classic pcap only (microsecond or nanosecond timestamps, Ethernet).
+//
+// The native tables never evict, whereas the kernel's are LRU: verdicts are
+// identical as long as the peak occupancy printed at the end stays within
+// the size of the kernel table (HONEYPOT_ATTACK_ENTRIES unless resized).
+//
+// The SYN-flood guard runs on capture time as on a one-CPU host, with
+// --baseline in place of syn_guard_cfg; --no-guard leaves it out. Its
+// admission lot draws from a fixed-seed generator, so a replay is
+// repeatable, but the lot differs from the kernel's: under a flood
+// verdicts agree in number rather than one by one.
+
+#include <arpa/inet.h>
+#include <bpf/bpf_endian.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "honeypot.h"
+#include "honeypot_core.h"
+
+namespace {
+
+// Open-addressing hash of u32 -> u32, linear probing, grown at 3/4 load.
+// Clearing is O(capacity), which a rotation every few minutes can afford.
+class flat_table {
+public:
+    flat_table() { slots_.resize(kInitial); }
+
+    uint32_t *find(uint32_t key) {
+        for (size_t i = hash(key);; i = (i + 1) & mask()) {
+            slot &s = slots_[i];
+            if (!s.used)
+                return nullptr;
+            if (s.key == key)
+                return &s.value;
+        }
+    }
+
+    uint32_t &insert(uint32_t key, uint32_t value) {
+        if ((size_ + 1) * 4 > slots_.size() * 3)
+            grow();
+        size_t i = hash(key);
+        while (slots_[i].used && slots_[i].key != key)
+            i = (i + 1) & mask();
+        if (!slots_[i].used) {
+            slots_[i].used = true;
+            slots_[i].key = key;
+            size_++;
+        }
+        slots_[i].value = value;
+        return slots_[i].value;
+    }
+
+    void clear() {
+        for (slot &s : slots_)
+            s.used = false;
+        size_ = 0;
+    }
+
+    size_t size() const { return size_; }
+
+private:
+    static constexpr size_t kInitial = 1024;
+
+    struct slot {
+        uint32_t key;
+        uint32_t value;
+        bool     used;
+    };
+
+    size_t mask() const { return slots_.size() - 1; }
+    size_t hash(uint32_t key) const {
+        return (static_cast<uint64_t>(key) * 0x9e3779b97f4a7c15ull >> 32) & mask();
+    }
+
+    void grow() {
+        std::vector<slot> old(slots_.size() * 2);
+        old.swap(slots_);
+        size_ = 0;
+        for (const slot &s : old)
+            if (s.used)
+                insert(s.key, s.value);
+    }
+
+    std::vector<slot> slots_;
+    size_t            size_ = 0;
+};
+
+struct flagged {
+    uint32_t src_ip;
+    uint32_t count;
+    uint64_t ts_ns;
+};
+
+// The maps of honeypot.cpp, in memory. Found by honeypot_decide() through
+// argument-dependent lookup on sim_policy *.
+struct sim_policy {
+    flat_table      tables[HONEYPOT_EPOCHS];
+    flat_table      verdicts;
+    flat_table      allowlist;
+    flat_table      intel;
+    honeypot_config cfg{};
+    uint64_t        now_ns = 0;
+    size_t          peak = 0;
+    uint64_t        intel_drops = 0;
+    std::vector<flagged> flags;
+    std::unordered_map<honeypot_flow_key, honeypot_flow, honeypot_flow_key_hash, honeypot_flow_key_eq> flows;
+    honeypot_guard        guard{};
+    honeypot_guard_cpu    guard_cpu{};    // the one CPU's slot
+    honeypot_guard_config guard_cfg{};
+    uint64_t              guard_syns = 0;
+    uint64_t              peak_rate = 0;
+    uint32_t              lot = 0x9e3779b9;
+
+    // guard_syn() of honeypot.cpp with one CPU: every tick is folded.
+    void count_syn() {
+        guard_syns++;
+        if (now_ns - guard.tick_ns < HONEYPOT_GUARD_TICK_NS)
+            return;
+        guard.rate = honeypot_guard_ewma(guard.rate, guard_syns, now_ns - guard.tick_ns);
+        guard.tick_ns = now_ns;
+        guard_syns = 0;
+        if (guard.rate > peak_rate)
+            peak_rate = guard.rate;
+    }
+
+    // honeypot-ctl rotate: advance the epoch, empty the oldest slot.
+    void rotate() {
+        cfg.epoch++;
+        tables[(cfg.epoch + 1) % HONEYPOT_EPOCHS].clear();
+    }
+};
+
+int hp_allowed(sim_policy *p, __u32 src_ip) { return p->allowlist.find(src_ip) != nullptr; }
+
+int hp_intel_blocked(sim_policy *p, __u32 src_ip) { return p->intel.find(src_ip) != nullptr; }
+
+const honeypot_config *hp_config(sim_policy *p) { return &p->cfg; }
+
+__u32 hp_peek_count(sim_policy *p, __u32 slot, __u32 src_ip) {
+    const uint32_t *count = p->tables[slot].find(src_ip);
+    return count ? *count : 0;
+}
+
+int hp_bump_count(sim_policy *p, __u32 slot, __u32 src_ip, __u32 *after) {
+    flat_table &t = p->tables[slot];
+    uint32_t *count = t.find(src_ip);
+    *after = count ? ++*count : t.insert(src_ip, 1);
+    if (t.size() > p->peak)
+        p->peak = t.size();
+    return 0;
+}
+
+int hp_flag(sim_policy *p, __u32 src_ip) {
+    if (p->verdicts.find(src_ip))
+        return 0;
+    p->verdicts.insert(src_ip, HONEYPOT_VERDICT_SHADOW);
+    return 1;
+}
+
+void hp_post(sim_policy *p, __u32 type, __u32 src_ip, __u32 count) {
+    if (type == HONEYPOT_EVENT_THRESHOLD)
+        p->flags.push_back({src_ip, count, p->now_ns});
+    else if (type == HONEYPOT_EVENT_INTEL_DROP)
+        p->intel_drops++;
+}
+
+int hp_guard(sim_policy *p, honeypot_guard_view *v) {
+    if (p->guard_cfg.off)
+        return 0;
+    if (p->now_ns - p->guard.tick_ns < HONEYPOT_GUARD_STALE * HONEYPOT_GUARD_TICK_NS)
+        v->rate = p->guard.rate;
+    v->baseline = p->guard_cfg.baseline ? p->guard_cfg.baseline : HONEYPOT_GUARD_BASELINE;
+    v->floor = p->guard_cfg.floor ? p->guard_cfg.floor : HONEYPOT_GUARD_FLOOR;
+    p->lot ^= p->lot << 13;     // xorshift32
+    p->lot ^= p->lot >> 17;
+    p->lot ^= p->lot << 5;
+    v->rnd = p->lot;
+    v->not_admitted = &p->guard_cpu.not_admitted;
+    return 1;
+}
+
+int load_addresses(const char *path, flat_table &out) {
+    std::ifstream in(path);
+    if (!in)
+        return -errno;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        in_addr addr;
+        if (inet_pton(AF_INET, line.c_str(), &addr) != 1) {
+            fprintf(stderr, "[honeypot-sim] %s: not an IPv4 address: %s\n", path, line.c_str());
+            return -EINVAL;
+        }
+        out.insert(addr.s_addr, 1);
+    }
+    return 0;
+}
+
+// Classic pcap framing (pcap-savefile(5)).
+constexpr uint32_t kPcapMagicUs = 0xa1b2c3d4, kPcapMagicNs = 0xa1b23c4d;
+constexpr uint32_t kLinktypeEthernet = 1;
+
+struct pcap_reader {
+    const unsigned char *p, *end;
+    bool swapped, nanos;
+
+    uint32_t u32(const unsigned char *at) const {
+        uint32_t v;
+        memcpy(&v, at, sizeof(v));
+        return swapped ? __builtin_bswap32(v) : v;
+    }
+
+    // -EINVAL for anything but an Ethernet capture in classic format.
+    int open(const unsigned char *data, size_t size) {
+        p = data;
+        end = data + size;
+        if (size < 24)
+            return -EINVAL;
+        uint32_t magic;
+        memcpy(&magic, data, sizeof(magic));
+        swapped = magic == __builtin_bswap32(kPcapMagicUs) || magic == __builtin_bswap32(kPcapMagicNs);
+        magic = swapped ? __builtin_bswap32(magic) : magic;
+        if (magic != kPcapMagicUs && magic != kPcapMagicNs)
+            return -EINVAL;
+        nanos = magic == kPcapMagicNs;
+        if ((u32(data + 20) & 0xffff) != kLinktypeEthernet)
+            return -EINVAL;
+        p += 24;
+        return 0;
+    }
+
+    bool next(const unsigned char *&frame, uint32_t &len, uint64_t &ts_ns) {
+        if (end - p < 16)
+            return false;
+        uint32_t sec = u32(p), frac = u32(p + 4);
+        len = u32(p + 8);
+        if (static_cast<size_t>(end - p - 16) < len)
+            return false;       // truncated capture
+        ts_ns = sec * 1000000000ull + (nanos ? frac : frac * 1000ull);
+        frame = p + 16;
+        p += 16 + len;
+        return true;
+    }
+};
+
+void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s <capture.pcap> [--threshold <n>] [--rotate <seconds>]\n"
+            "          [--allowlist <file>] [--intel <file>] [--verdicts <out>]\n"
+            "          [--baseline <syns-per-second>] [--no-guard]\n", argv0);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const char *pcap_path = nullptr, *verdicts_path = nullptr;
+    const char *allow_path = nullptr, *intel_path = nullptr;
+    uint32_t threshold = 0, baseline = 0;
+    bool guard = true;
+    double rotate_s = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--threshold") && i + 1 < argc) {
+            threshold = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (!strcmp(argv[i], "--rotate") && i + 1 < argc) {
+            rotate_s = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--allowlist") && i + 1 < argc) {
+            allow_path = argv[++i];
+        } else if (!strcmp(argv[i], "--intel") && i + 1 < argc) {
+            intel_path = argv[++i];
+        } else if (!strcmp(argv[i], "--verdicts") && i + 1 < argc) {
+            verdicts_path = argv[++i];
+        } else if (!strcmp(argv[i], "--baseline") && i + 1 < argc) {
+            baseline = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (!strcmp(argv[i], "--no-guard")) {
+            guard = false;
+        } else if (argv[i][0] != '-' && !pcap_path) {
+            pcap_path = argv[i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!pcap_path) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    auto policy = std::make_unique<sim_policy>();
+    policy->cfg.threshold = threshold;
+    policy->guard_cfg.baseline = baseline;
+    policy->guard_cfg.off = !guard;
+    int err = 0;
+    if (allow_path && (err = load_addresses(allow_path, policy->allowlist)))
+        fprintf(stderr, "[honeypot-sim] %s: %s\n", allow_path, strerror(-err));
+    if (!err && intel_path && (err = load_addresses(intel_path, policy->intel)))
+        fprintf(stderr, "[honeypot-sim] %s: %s\n", intel_path, strerror(-err));
+    if (err)
+        return 1;
+
+    int fd = open(pcap_path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st)) {
+        fprintf(stderr, "[honeypot-sim] %s: %s\n", pcap_path, strerror(errno));
+        return 1;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    void *map = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    pcap_reader reader;
+    if (map == MAP_FAILED || reader.open(static_cast<const unsigned char *>(map), size)) {
+        fprintf(stderr, "[honeypot-sim] %s: not a classic Ethernet pcap\n", pcap_path);
+        return 1;
+    }
+
+    uint64_t rotate_ns = static_cast<uint64_t>(rotate_s * 1e9), next_rotation = 0;
+    uint64_t frames = 0, ssh = 0, rotations = 0, first_ts = 0;
+    const unsigned char *frame;
+    uint32_t len;
+    uint64_t ts;
+    auto t0 = std::chrono::steady_clock::now();
+    while (reader.next(frame, len, ts)) {
+        if (!frames++) {
+            first_ts = ts;
+            next_rotation = ts + rotate_ns;
+        }
+        while (rotate_ns && ts >= next_rotation) {
+            policy->rotate();
+            next_rotation += rotate_ns;
+            rotations++;
+        }
+        __u32 src_ip;
+        if (!honeypot_parse(frame, frame + len, &src_ip))
+            continue;
+        ssh++;
+        policy->now_ns = ts;
+        // As in the kernel: a SYN is an attempt, and so is each further
+        // authentication attempt estimated inside a connection.
+        honeypot_syn_fp fp;
+        int syn = honeypot_syn_fingerprint(frame, frame + len, &fp);
+        if (syn)
+            policy->count_syn();
+        int attempt = syn || honeypot_track_flow(policy->flows, frame, frame + len);
+        honeypot_decide(policy.get(), src_ip, nullptr, nullptr, attempt);
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    munmap(map, size);
+
+    if (verdicts_path) {
+        FILE *out = fopen(verdicts_path, "w");
+        if (!out) {
+            fprintf(stderr, "[honeypot-sim] %s: %s\n", verdicts_path, strerror(errno));
+            return 1;
+        }
+        for (const flagged &f : policy->flags) {
+            char ip[INET_ADDRSTRLEN];
+            in_addr addr{f.src_ip};
+            inet_ntop(AF_INET, &addr, ip, sizeof(ip));
+            fprintf(out, "%s %u %.6f\n", ip, f.count, (f.ts_ns - first_ts) / 1e9);
+        }
+        fclose(out);
+    }
+
+    printf("[honeypot-sim] %llu frames (%llu to port %d) in %.3f s: %.1f Mpps\n",
+           static_cast<unsigned long long>(frames), static_cast<unsigned long long>(ssh),
+           HONEYPOT_SSH_PORT, secs, secs > 0 ? frames / secs / 1e6 : 0.0);
+    printf("[honeypot-sim] flagged %zu sources, dropped %llu intel packets, %llu rotations\n",
+           policy->flags.size(), static_cast<unsigned long long>(policy->intel_drops),
+           static_cast<unsigned long long>(rotations));
+    printf("[honeypot-sim] peak table occupancy %zu (default kernel table: %d)\n",
+           policy->peak, HONEYPOT_ATTACK_ENTRIES);
+    if (guard)
+        printf("[honeypot-sim] flood guard: peak %llu SSH SYNs/s, %llu SYNs of new sources not admitted\n",
+               static_cast<unsigned long long>(policy->peak_rate >> HONEYPOT_GUARD_SHIFT),
+               static_cast<unsigned long long>(policy->guard_cpu.not_admitted));
+    return 0;
+}
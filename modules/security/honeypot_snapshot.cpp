@@ -0,0 +1,252 @@
+// modules/security/honeypot_snapshot.cpp — warm-restart checkpoints of attack_map
+// Saves the pinned attack_map to a compact binary file and bulk-loads it back
+// after a reboot, so known offenders do not get a fresh THRESHOLD budget.
+//
+// Build: clang++ -O2 -std=c++17 honeypot_snapshot.cpp -lbpf -o honeypot-snapshot
+// Usage: honeypot-snapshot save <file> [--every <seconds>]
+//        honeypot-snapshot load <file>
+//
+// File layout (host endian, 8-byte aligned, meant to be mmap'd as-is):
+//   snapshot_header   magic "OCHPSNAP", version, record size, record count
+//   snapshot_record[] { src_ip, count } sorted by src_ip (raw key value),
+//                     so readers can binary-search the mapping directly.
+// Files are written to <file>.tmp and renamed, so a crash mid-checkpoint
+// leaves the previous snapshot intact.
+
+#include <bpf/bpf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "honeypot.h"
+#include "honeypot_maps.h"
+
+namespace {
+
+constexpr char     kMagic[8]   = {'O', 'C', 'H', 'P', 'S', 'N', 'A', 'P'};
+constexpr uint32_t kVersion    = 1;
+
+struct snapshot_header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t count;
+    uint64_t saved_at;    // CLOCK_REALTIME seconds
+    uint64_t reserved;
+};
+
+struct snapshot_record {
+    uint32_t src_ip;      // network order, exactly as keyed in attack_map
+    uint32_t count;
+};
+
+static_assert(sizeof(snapshot_header) == 40, "snapshot_header layout is part of the file format");
+static_assert(sizeof(snapshot_record) == 8, "snapshot_record layout is part of the file format");
+
+double elapsed_ms(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int open_pinned(const char *pin) {
+    int fd = bpf_obj_get(pin);
+    if (fd < 0)
+        fprintf(stderr, "[honeypot-snapshot] %s: %s (run honeypot-loader attach first)\n",
+                pin, strerror(errno));
+    return fd;
+}
+
+// Saves the window the program currently sees (current + previous epoch).
+int save(int holder_fd, int cfg_fd, const std::string &path) {
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<snapshot_record> recs;
+    int err = honeypot_dump_window(holder_fd, cfg_fd, recs);
+    if (err) {
+        fprintf(stderr, "[honeypot-snapshot] batch dump: %s\n", strerror(-err));
+        return err;
+    }
+    std::sort(recs.begin(), recs.end(),
+              [](const snapshot_record &a, const snapshot_record &b) { return a.src_ip < b.src_ip; });
+
+    snapshot_header hdr{};
+    memcpy(hdr.magic, kMagic, sizeof(kMagic));
+    hdr.version     = kVersion;
+    hdr.record_size = sizeof(snapshot_record);
+    hdr.count       = recs.size();
+    hdr.saved_at    = static_cast<uint64_t>(time(nullptr));
+
+    const std::string tmp = path + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        fprintf(stderr, "[honeypot-snapshot] %s: %s\n", tmp.c_str(), strerror(errno));
+        return -errno;
+    }
+    const size_t body = recs.size() * sizeof(snapshot_record);
+    bool ok = write(fd, &hdr, sizeof(hdr)) == static_cast<ssize_t>(sizeof(hdr)) &&
+              (body == 0 || write(fd, recs.data(), body) == static_cast<ssize_t>(body)) &&
+              fsync(fd) == 0;
+    err = ok ? 0 : -errno;
+    close(fd);
+    if (ok && rename(tmp.c_str(), path.c_str()))
+        err = -errno;
+    if (err) {
+        fprintf(stderr, "[honeypot-snapshot] write %s: %s\n", path.c_str(), strerror(-err));
+        unlink(tmp.c_str());
+        return err;
+    }
+    printf("[honeypot-snapshot] saved %zu offenders to %s in %.1f ms\n",
+           recs.size(), path.c_str(), elapsed_ms(t0));
+    return 0;
+}
+
+// Restores into the current epoch's table.
+int load(int holder_fd, int cfg_fd, const std::string &path) {
+    auto t0 = std::chrono::steady_clock::now();
+    int epoch = honeypot_current_epoch(cfg_fd);
+    int map_fd = epoch < 0 ? epoch : honeypot_open_table(holder_fd, static_cast<__u32>(epoch));
+    if (map_fd < 0) {
+        fprintf(stderr, "[honeypot-snapshot] attack_map table: %s\n", strerror(-map_fd));
+        return map_fd;
+    }
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "[honeypot-snapshot] %s: %s\n", path.c_str(), strerror(errno));
+        int err = -errno;
+        close(map_fd);
+        return err;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) || static_cast<size_t>(st.st_size) < sizeof(snapshot_header)) {
+        fprintf(stderr, "[honeypot-snapshot] %s: truncated snapshot\n", path.c_str());
+        close(fd);
+        close(map_fd);
+        return -EINVAL;
+    }
+    void *base = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "[honeypot-snapshot] mmap %s: %s\n", path.c_str(), strerror(errno));
+        int err = -errno;
+        close(map_fd);
+        return err;
+    }
+
+    const auto *hdr = static_cast<const snapshot_header *>(base);
+    const uint64_t room = (static_cast<uint64_t>(st.st_size) - sizeof(*hdr)) / sizeof(snapshot_record);
+    if (memcmp(hdr->magic, kMagic, sizeof(kMagic)) || hdr->version != kVersion ||
+        hdr->record_size != sizeof(snapshot_record) || hdr->count > room) {
+        fprintf(stderr, "[honeypot-snapshot] %s: not a v%u snapshot\n", path.c_str(), kVersion);
+        munmap(base, st.st_size);
+        close(map_fd);
+        return -EINVAL;
+    }
+
+    // Counters that are already live are newer than the checkpoint. The
+    // generic batch update takes no BPF_NOEXIST, so the live keys are read
+    // once up front and left out; a source first seen while the restore
+    // runs may get its checkpointed count back instead of its new one.
+    std::vector<snapshot_record> live;
+    int err = honeypot_dump_table(map_fd, live);
+    if (err) {
+        fprintf(stderr, "[honeypot-snapshot] attack_map table: %s\n", strerror(-err));
+        munmap(base, st.st_size);
+        close(map_fd);
+        return err;
+    }
+    std::vector<uint32_t> live_keys;
+    live_keys.reserve(live.size());
+    for (const snapshot_record &r : live)
+        live_keys.push_back(r.src_ip);
+    std::sort(live_keys.begin(), live_keys.end());
+
+    // Records are fixed-width, so keys and values are gathered into the two
+    // flat arrays BPF_MAP_UPDATE_BATCH wants one chunk at a time.
+    const auto *recs = reinterpret_cast<const snapshot_record *>(hdr + 1);
+    std::vector<uint32_t> keys(kHoneypotBatch), vals(kHoneypotBatch);
+    bpf_map_batch_opts opts{};
+    opts.sz = sizeof(opts);
+
+    uint64_t loaded = 0, skipped = 0;
+    for (uint64_t off = 0; off < hdr->count;) {
+        uint64_t end = std::min<uint64_t>(off + kHoneypotBatch, hdr->count);
+        uint32_t n = 0;
+        for (; off < end; off++) {
+            if (std::binary_search(live_keys.begin(), live_keys.end(), recs[off].src_ip)) {
+                skipped++;
+                continue;
+            }
+            keys[n] = recs[off].src_ip;
+            vals[n] = recs[off].count;
+            n++;
+        }
+        uint32_t done = n;
+        if (n && bpf_map_update_batch(map_fd, keys.data(), vals.data(), &done, &opts)) {
+            err = -errno;
+            fprintf(stderr, "[honeypot-snapshot] batch update: %s\n", strerror(errno));
+            loaded += done;
+            break;
+        }
+        loaded += done;
+    }
+    munmap(base, st.st_size);
+    close(map_fd);
+    printf("[honeypot-snapshot] restored %llu offenders (%llu already live) from %s in %.1f ms\n",
+           static_cast<unsigned long long>(loaded),
+           static_cast<unsigned long long>(skipped), path.c_str(), elapsed_ms(t0));
+    return err;
+}
+
+void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s save <file> [--every <seconds>]\n"
+            "       %s load <file>\n",
+            argv0, argv0);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        usage(argv[0]);
+        return 2;
+    }
+    const std::string cmd = argv[1], path = argv[2];
+    unsigned long every = 0;
+    bool ok = argc == 3 ? cmd == "save" || cmd == "load"
+                        : cmd == "save" && argc == 5 && !strcmp(argv[3], "--every") &&
+                              honeypot_parse_num(argv[4], 10, 0, UINT32_MAX, every);
+    if (!ok) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int holder_fd = open_pinned(HONEYPOT_ATTACK_MAP_PIN);
+    int cfg_fd = holder_fd < 0 ? -1 : open_pinned(HONEYPOT_CFG_PIN);
+    if (cfg_fd < 0)
+        return 1;
+
+    int err;
+    if (cmd == "load") {
+        err = load(holder_fd, cfg_fd, path);
+    } else {
+        err = save(holder_fd, cfg_fd, path);
+        while (every) {
+            std::this_thread::sleep_for(std::chrono::seconds(every));
+            err = save(holder_fd, cfg_fd, path);
+        }
+    }
+    close(cfg_fd);
+    close(holder_fd);
+    return err ? 1 : 0;
+}
@@ -1,7 +1,14 @@
 #!/usr/bin/env python3
 """
-iptables_helper.py — Reads the eBPF attack_map via bpftool and inserts
-iptables TPROXY rules to redirect repeat offenders to the shadow shell.
+iptables_helper.py — Reads the eBPF attack_map and inserts iptables TPROXY
+rules to redirect repeat offenders to the shadow shell. Reads go through the
+omniclaw_honeypot extension (honeypot_py.cpp) when it is built, and fall
+back to bpftool otherwise.
+
+Fallback only: where honeypot-loader could attach sk_lookup_shadow, flagged
+sources are already steered in-kernel and no per-IP rule is needed. Rules
+added here are never removed; offender-controller (offender_controller.cpp)
+bans with expiring, escalating lifetimes instead.
 """
 
 import json
@@ -11,12 +18,23 @@ import struct
 import subprocess
 import time
 
+try:
+    import omniclaw_honeypot  # honeypot_py.cpp: direct bpf() syscalls
+except ImportError:
+    omniclaw_honeypot = None
+
 logging.basicConfig(level=logging.INFO,
                     format="%(asctime)s - %(name)s - %(levelname)s - %(message)s")
 logger = logging.getLogger("IPTablesHelper")
 
 SHADOW_PORT = 2222
-THRESHOLD = 5
+DEFAULT_THRESHOLD = 5  # HONEYPOT_DEFAULT_THRESHOLD, for honeypot_cfg.threshold 0
+# Holder map pinned by honeypot-loader: one counter table per epoch slot.
+# honeypot_cfg says which slot is current; the detector sums it with the
+# previous one (see honeypot.h).
+ATTACK_MAP_PIN = "/sys/fs/bpf/omniclaw/attack_map"
+CFG_PIN = "/sys/fs/bpf/omniclaw/honeypot_cfg"
+EPOCHS = 3
 REDIRECTED = set()  # track already-redirected IPs
 
 
@@ -25,28 +43,70 @@ def int_to_ip(ip_int: int) -> str:
     return socket.inet_ntoa(struct.pack("!I", ip_int))
 
 
+def _hex_bytes(field) -> bytes:
+    """Decode bpftool's raw ["0x0a", "0x00", ...] key/value encoding."""
+    return bytes(int(b, 16) for b in field)
+
+
+def _lookup_pinned(pin: str, index: int) -> dict:
+    """Look up a u32-keyed entry of a pinned map via bpftool."""
+    key = [str(b) for b in index.to_bytes(4, "little")]
+    result = subprocess.run(
+        ["bpftool", "map", "lookup", "pinned", pin, "key", *key, "-j"],
+        capture_output=True, text=True, timeout=10,
+    )
+    if result.returncode != 0:
+        raise RuntimeError(result.stderr.strip() or f"{pin} lookup failed")
+    return json.loads(result.stdout)
+
+
+def _attack_table_id(slot: int) -> int:
+    """Return the id of the counter table in an attack_map slot."""
+    entry = _lookup_pinned(ATTACK_MAP_PIN, slot)
+    if "inner_map_id" in entry:
+        return entry["inner_map_id"]
+    return int.from_bytes(_hex_bytes(entry["value"]), "little")
+
+
+def _window() -> tuple:
+    """Current and previous epoch slots, and the threshold, as the detector
+    counts them (struct honeypot_config: u32 epoch, u32 threshold)."""
+    cfg = _hex_bytes(_lookup_pinned(CFG_PIN, 0)["value"])
+    epoch = int.from_bytes(cfg[:4], "little") % EPOCHS
+    threshold = int.from_bytes(cfg[4:8], "little") or DEFAULT_THRESHOLD
+    return [epoch, (epoch + EPOCHS - 1) % EPOCHS], threshold
+
+
 def get_attackers() -> list:
     """Dump the eBPF attack_map and return IPs above threshold."""
-    try:
-        result = subprocess.run(
-            ["bpftool", "map", "dump", "name", "attack_map", "-j"],
-            capture_output=True, text=True, timeout=10,
-        )
-        if result.returncode != 0:
+    if omniclaw_honeypot is not None:
+        try:
+            return [ip for ip, _ in omniclaw_honeypot.Controller().offenders().items()]
+        except OSError as e:
+            logger.error(f"attack_map read failed: {e}")
             return []
-        entries = json.loads(result.stdout)
-        attackers = []
-        for entry in entries:
-            count = entry.get("value", 0)
-            if isinstance(count, list):
-                count = count[0] if count else 0
-            if count > THRESHOLD:
-                ip_int = entry.get("key", 0)
-                if isinstance(ip_int, list):
-                    ip_int = ip_int[0] if ip_int else 0
-                ip = int_to_ip(ip_int)
-                attackers.append(ip)
-        return attackers
+    try:
+        counts = {}
+        slots, threshold = _window()
+        for slot in slots:
+            result = subprocess.run(
+                ["bpftool", "map", "dump", "id", str(_attack_table_id(slot)), "-j"],
+                capture_output=True, text=True, timeout=10,
+            )
+            if result.returncode != 0:
+                return []
+            for entry in json.loads(result.stdout):
+                count = entry.get("value", 0)
+                if isinstance(count, list):
+                    count = int.from_bytes(_hex_bytes(count), "little")
+                key = entry.get("key", 0)
+                if isinstance(key, list):
+                    # The key is saddr as seen on the wire: network order.
+                    ip = socket.inet_ntoa(_hex_bytes(key))
+                else:
+                    ip = int_to_ip(key)
+                counts[ip] = counts.get(ip, 0) + count
+        return [ip for ip, count in counts.items() if count > threshold]
     except Exception as e:
         logger.error(f"bpftool dump failed: {e}")
         return []
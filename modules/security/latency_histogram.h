@@ -0,0 +1,87 @@
+// modules/security/latency_histogram.h — HDR-style latency histogram
+// Log-linear buckets: exact below 128 us, then 64 sub-buckets per power of
+// two, so every recorded value is within 1/64 (1.6%) of its bucket at any
+// magnitude up to 2^40 us (~12 days). Recording is a clz and an increment;
+// the whole histogram is a fixed 18 KiB array. Header-only like
+// honeypot_maps.h.
+
+#ifndef OMNICLAW_LATENCY_HISTOGRAM_H
+#define OMNICLAW_LATENCY_HISTOGRAM_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+class latency_histogram {
+public:
+    void record(uint64_t us) {
+        if (us > kMaxValue)
+            us = kMaxValue;
+        counts_[index(us)]++;
+        total_++;
+        sum_ += us;
+        if (us > max_)
+            max_ = us;
+    }
+
+    uint64_t count() const { return total_; }
+    uint64_t sum() const { return sum_; }
+    uint64_t max() const { return max_; }
+
+    // Smallest bucket upper bound at or below which a fraction q of the
+    // recorded values lie; 0 when empty.
+    uint64_t quantile(double q) const {
+        if (!total_)
+            return 0;
+        uint64_t want = static_cast<uint64_t>(q * static_cast<double>(total_) + 0.5);
+        if (want < 1)
+            want = 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBuckets; i++) {
+            seen += counts_[i];
+            if (seen >= want)
+                return upper(i) < max_ ? upper(i) : max_;
+        }
+        return max_;
+    }
+
+    // Values in buckets that lie wholly at or below us (a lower bound on
+    // the true count), for SLO ratios.
+    uint64_t count_at_or_below(uint64_t us) const {
+        uint64_t n = 0;
+        for (size_t i = 0; i < kBuckets && upper(i) <= us; i++)
+            n += counts_[i];
+        return n;
+    }
+
+private:
+    static constexpr unsigned kSubBits = 6;                     // 64 sub-buckets
+    static constexpr unsigned kMaxExp = 40;
+    static constexpr uint64_t kLinear = uint64_t{2} << kSubBits;   // 128
+    static constexpr uint64_t kMaxValue = (uint64_t{1} << kMaxExp) - 1;
+    static constexpr size_t   kBuckets = kLinear + (kMaxExp - kSubBits - 1) * (size_t{1} << kSubBits);
+
+    static size_t index(uint64_t v) {
+        if (v < kLinear)
+            return static_cast<size_t>(v);
+        unsigned exp = 63 - static_cast<unsigned>(__builtin_clzll(v));   // >= kSubBits + 1
+        unsigned shift = exp - kSubBits;
+        uint64_t sub = (v >> shift) - (uint64_t{1} << kSubBits);        // 0..63
+        return static_cast<size_t>(kLinear + (exp - kSubBits - 1) * (uint64_t{1} << kSubBits) + sub);
+    }
+
+    // Largest value that maps to bucket i.
+    static uint64_t upper(size_t i) {
+        if (i < kLinear)
+            return i;
+        size_t k = i - kLinear;
+        unsigned shift = static_cast<unsigned>(k >> kSubBits) + 1;
+        uint64_t sub = (k & ((size_t{1} << kSubBits) - 1)) + (uint64_t{1} << kSubBits);
+        return ((sub + 1) << shift) - 1;
+    }
+
+    std::array<uint64_t, kBuckets> counts_{};
+    uint64_t                       total_ = 0, sum_ = 0, max_ = 0;
+};
+
+#endif // OMNICLAW_LATENCY_HISTOGRAM_H
@@ -0,0 +1,266 @@
+// modules/security/nft_set.h — batched updates of an nftables set over netlink
+// Talks nf_tables directly on a NETLINK_NETFILTER socket (no nft process,
+// no xtables lock). The additions and removals of one commit() travel in
+// NFNL batches, which the kernel applies as one transaction each: either
+// every element of a batch lands or none does. A batch must fit the
+// socket's send buffer (net.core.wmem_max caps what open() asks for), so
+// large updates go out as several batches in a row; replace() then leaves
+// the set short of its later elements until the last batch is in.
+// Header-only like honeypot_maps.h.
+
+#ifndef OMNICLAW_NFT_SET_H
+#define OMNICLAW_NFT_SET_H
+
+#include <arpa/inet.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nf_tables.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef SOL_NETLINK
+#define SOL_NETLINK 270
+#endif
+
+class nft_set {
+public:
+    // family is an NFPROTO_* value; the table and set must already exist
+    // (see honeypot.nft).
+    nft_set(uint8_t family, std::string table, std::string set)
+        : family_(family), table_(std::move(table)), set_(std::move(set)) {}
+
+    ~nft_set() {
+        if (fd_ >= 0)
+            close(fd_);
+    }
+
+    nft_set(const nft_set &) = delete;
+    nft_set &operator=(const nft_set &) = delete;
+
+    int open() {
+        fd_ = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_NETFILTER);
+        if (fd_ < 0)
+            return -errno;
+        sockaddr_nl sa{};
+        sa.nl_family = AF_NETLINK;
+        if (bind(fd_, reinterpret_cast<sockaddr *>(&sa), sizeof(sa)))
+            return -errno;
+        int sz = 8 << 20;
+        setsockopt(fd_, SOL_SOCKET, SO_SNDBUF, &sz, sizeof(sz));
+        setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &sz, sizeof(sz));
+        // What the kernel granted, less the slack netlink_sendmsg() keeps.
+        socklen_t len = sizeof(sz);
+        if (getsockopt(fd_, SOL_SOCKET, SO_SNDBUF, &sz, &len))
+            return -errno;
+        limit_ = static_cast<size_t>(sz) > kSndbufSlack ? static_cast<size_t>(sz) - kSndbufSlack : 0;
+        if (limit_ < msg_bytes(1) + 2 * NLMSG_SPACE(sizeof(nfgenmsg)))
+            return -ENOBUFS;
+        // Error acks carry the failing header only, plus the kernel's
+        // explanation when it has one.
+        int one = 1;
+        setsockopt(fd_, SOL_NETLINK, NETLINK_CAP_ACK, &one, sizeof(one));
+        setsockopt(fd_, SOL_NETLINK, NETLINK_EXT_ACK, &one, sizeof(one));
+        return 0;
+    }
+
+    // Adds and removes IPv4 addresses (network order), in one transaction
+    // unless they outgrow the send buffer. Adding a present element is not
+    // an error; removing an absent one is, and aborts that batch and the
+    // ones after it, so callers resync with replace() then.
+    int commit(const std::vector<uint32_t> &add, const std::vector<uint32_t> &del) {
+        if (add.empty() && del.empty())
+            return 0;
+        begin_batch();
+        int err = put_elems(NFT_MSG_DELSETELEM, del);
+        if (!err)
+            err = put_elems(NFT_MSG_NEWSETELEM, add);
+        return err ? err : send_batch();
+    }
+
+    // Flushes the set and fills it with exactly addrs; atomically when they
+    // fit one batch, else the flush goes with the first one.
+    int replace(const std::vector<uint32_t> &addrs) {
+        begin_batch();
+        begin_msg(NFT_MSG_DELSETELEM, 0);   // no element list: flush
+        put_strings();
+        end_msg();
+        int err = put_elems(NFT_MSG_NEWSETELEM, addrs);
+        return err ? err : send_batch();
+    }
+
+private:
+    // Elements per NEWSETELEM/DELSETELEM message. Each costs 16 bytes of
+    // nested attributes and the element list's nla_len is 16 bits, so a
+    // message stays at 32 KiB; a batch may hold any number of messages.
+    static constexpr size_t kElemsPerMsg = 2048;
+    static constexpr size_t kElemBytes = 16;        // NFTA_LIST_ELEM > KEY > DATA_VALUE
+    static constexpr size_t kSndbufSlack = 4096;
+    // Largest ack: the error header with NETLINK_CAP_ACK and extended-ack
+    // attributes; anything longer is reported as truncated.
+    static constexpr size_t kAckBytes = 16384;
+
+    // Bytes of an element message with n elements.
+    size_t msg_bytes(size_t n) const {
+        return NLMSG_SPACE(sizeof(nfgenmsg)) + NLA_ALIGN(NLA_HDRLEN + table_.size() + 1) +
+               NLA_ALIGN(NLA_HDRLEN + set_.size() + 1) + NLA_HDRLEN + n * kElemBytes;
+    }
+
+    void begin_batch() {
+        buf_.clear();
+        acks_ = 0;
+        first_seq_ = seq_;
+        put_control(NFNL_MSG_BATCH_BEGIN);
+    }
+
+    int send_batch() {
+        put_control(NFNL_MSG_BATCH_END);
+        sockaddr_nl sa{};
+        sa.nl_family = AF_NETLINK;
+        if (sendto(fd_, buf_.data(), buf_.size(), 0, reinterpret_cast<sockaddr *>(&sa), sizeof(sa)) < 0)
+            return -errno;
+        return wait_acks();
+    }
+
+    // Sends the batch so far when a message of n more elements would take
+    // it past the send buffer, and starts the next one.
+    int make_room(size_t n) {
+        if (buf_.size() + msg_bytes(n) + NLMSG_SPACE(sizeof(nfgenmsg)) <= limit_ || acks_ == 0)
+            return 0;
+        int err = send_batch();
+        if (!err)
+            begin_batch();
+        return err;
+    }
+
+    // Every nf_tables message asks for an ack; the first error (the kernel
+    // stops processing the batch there) is returned.
+    int wait_acks() {
+        rx_.resize(kAckBytes);
+        while (acks_ > 0) {
+            ssize_t n = recv(fd_, rx_.data(), rx_.size(), MSG_TRUNC);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                return -errno;
+            }
+            if (static_cast<size_t>(n) > rx_.size()) {
+                // Still read the error code at the front, so a failed batch,
+                // which sends no more acks, cannot leave us waiting.
+                const auto *nh = reinterpret_cast<const nlmsghdr *>(rx_.data());
+                if (nh->nlmsg_type == NLMSG_ERROR && nh->nlmsg_seq >= first_seq_) {
+                    int err = static_cast<const nlmsgerr *>(NLMSG_DATA(nh))->error;
+                    return err ? err : -EMSGSIZE;
+                }
+                return -EMSGSIZE;
+            }
+            int len = static_cast<int>(n);
+            for (auto *nh = reinterpret_cast<nlmsghdr *>(rx_.data()); NLMSG_OK(nh, len);
+                 nh = NLMSG_NEXT(nh, len)) {
+                if (nh->nlmsg_type != NLMSG_ERROR || nh->nlmsg_seq < first_seq_)
+                    continue;
+                int err = static_cast<nlmsgerr *>(NLMSG_DATA(nh))->error;
+                if (err)
+                    return err;
+                acks_--;
+            }
+        }
+        return 0;
+    }
+
+    nlmsghdr *begin_msg(uint16_t type, uint16_t flags) {
+        msg_ = buf_.size();
+        buf_.resize(msg_ + NLMSG_SPACE(sizeof(nfgenmsg)));
+        auto *nh = reinterpret_cast<nlmsghdr *>(&buf_[msg_]);
+        nh->nlmsg_type = static_cast<uint16_t>(NFNL_SUBSYS_NFTABLES << 8 | type);
+        nh->nlmsg_flags = static_cast<uint16_t>(NLM_F_REQUEST | NLM_F_ACK | flags);
+        nh->nlmsg_seq = seq_++;
+        auto *nfg = static_cast<nfgenmsg *>(NLMSG_DATA(nh));
+        nfg->nfgen_family = family_;
+        nfg->version = NFNETLINK_V0;
+        nfg->res_id = 0;
+        acks_++;
+        return nh;
+    }
+
+    void end_msg() {
+        reinterpret_cast<nlmsghdr *>(&buf_[msg_])->nlmsg_len = static_cast<uint32_t>(buf_.size() - msg_);
+    }
+
+    void put_control(uint16_t type) {
+        size_t off = buf_.size();
+        buf_.resize(off + NLMSG_SPACE(sizeof(nfgenmsg)));
+        auto *nh = reinterpret_cast<nlmsghdr *>(&buf_[off]);
+        nh->nlmsg_len = NLMSG_LENGTH(sizeof(nfgenmsg));
+        nh->nlmsg_type = type;
+        nh->nlmsg_flags = NLM_F_REQUEST;
+        nh->nlmsg_seq = seq_++;
+        auto *nfg = static_cast<nfgenmsg *>(NLMSG_DATA(nh));
+        nfg->nfgen_family = AF_UNSPEC;
+        nfg->version = NFNETLINK_V0;
+        nfg->res_id = htons(NFNL_SUBSYS_NFTABLES);
+    }
+
+    void put_attr(uint16_t type, const void *data, size_t len) {
+        size_t off = buf_.size();
+        buf_.resize(off + NLA_ALIGN(NLA_HDRLEN + len));
+        auto *nla = reinterpret_cast<nlattr *>(&buf_[off]);
+        nla->nla_type = type;
+        nla->nla_len = static_cast<uint16_t>(NLA_HDRLEN + len);
+        if (len)
+            memcpy(&buf_[off + NLA_HDRLEN], data, len);
+    }
+
+    size_t nest_begin(uint16_t type) {
+        size_t off = buf_.size();
+        put_attr(static_cast<uint16_t>(type | NLA_F_NESTED), nullptr, 0);
+        return off;
+    }
+
+    void nest_end(size_t off) {
+        reinterpret_cast<nlattr *>(&buf_[off])->nla_len = static_cast<uint16_t>(buf_.size() - off);
+    }
+
+    void put_strings() {
+        put_attr(NFTA_SET_ELEM_LIST_TABLE, table_.c_str(), table_.size() + 1);
+        put_attr(NFTA_SET_ELEM_LIST_SET, set_.c_str(), set_.size() + 1);
+    }
+
+    int put_elems(uint16_t type, const std::vector<uint32_t> &addrs) {
+        for (size_t off = 0; off < addrs.size(); off += kElemsPerMsg) {
+            size_t end = std::min(addrs.size(), off + kElemsPerMsg);
+            if (int err = make_room(end - off))
+                return err;
+            begin_msg(type, type == NFT_MSG_NEWSETELEM ? NLM_F_CREATE : 0);
+            put_strings();
+            size_t list = nest_begin(NFTA_SET_ELEM_LIST_ELEMENTS);
+            for (size_t i = off; i < end; i++) {
+                size_t elem = nest_begin(NFTA_LIST_ELEM);
+                size_t key = nest_begin(NFTA_SET_ELEM_KEY);
+                put_attr(NFTA_DATA_VALUE, &addrs[i], sizeof(addrs[i]));
+                nest_end(key);
+                nest_end(elem);
+            }
+            nest_end(list);
+            end_msg();
+        }
+        return 0;
+    }
+
+    uint8_t           family_;
+    std::string       table_, set_;
+    int               fd_ = -1;
+    uint32_t          seq_ = 1, first_seq_ = 1;
+    size_t            acks_ = 0, msg_ = 0, limit_ = 0;
+    std::vector<char> buf_, rx_;
+};
+
+#endif // OMNICLAW_NFT_SET_H
@@ -0,0 +1,537 @@
+// modules/security/offender_controller.cpp — ban lifetimes for flagged sources
+// verdict_map says who crossed the threshold; this controller decides for
+// how long. Each newly flagged source is banned for a duration that doubles
+// with every repeat offence (capped), and the expiry is filed in a
+// hierarchical timer wheel so arming and expiring a ban is O(1) however many
+// are live. The new bans and the expired ones go to each active
+// enforcement backend together, as one batch:
+//
+//   verdict_map  expired sources are deleted, which stops sk_lookup steering
+//                and lets the XDP program flag them again on a repeat offence
+//   nftables     the offenders set of honeypot.nft, one netlink transaction
+//                per batch (skip with --no-nft on sk_lookup-only hosts)
+//
+// A source's offence count is forgotten once it stays clean for --forget
+// seconds after its last ban.
+//
+// Threshold events from the per-CPU rings of honeypot_events, drained
+// through one epoll set, start a batch at once; the verdict_map scan every
+// --tick-ms only catches what the rings dropped. Each event's kernel
+// timestamp is carried through to the moment every backend holds the ban,
+// and those time-to-mitigate samples feed an HDR histogram exported to
+// --metrics in the Prometheus text format, with breaches of --slo-ms
+// counted separately and the share within it exported as a ratio. The
+// same file carries the per-CPU event counters, so sampling and ring
+// overflows are visible as exact drop counts.
+//
+// With --bus (e.g. /omniclaw_events) every drained event is also
+// republished into the shared-memory ring of event_bus.h, which Python
+// services read in place through event_bus.py.
+//
+// Build: clang++ -O2 -std=c++17 offender_controller.cpp -lbpf -o offender-controller
+// Usage: offender-controller [--tick-ms <ms>] [--ban <s>] [--ban-max <s>] [--forget <s>]
+//                            [--table <name>] [--set <name>] [--no-nft]
+//                            [--metrics <file.prom>] [--slo-ms <ms>] [--bus <shm-name>]
+
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <unordered_map>
+#include <vector>
+
+#include "event_bus.h"
+#include "honeypot.h"
+#include "honeypot_maps.h"
+#include "latency_histogram.h"
+#include "nft_set.h"
+#include "timer_wheel.h"
+
+namespace {
+
+struct verdict {
+    uint32_t src_ip;
+    uint32_t flags;
+};
+
+// Source addresses verdict_map currently flags for the shadow shell.
+int flagged_sources(int verdict_fd, std::vector<uint32_t> &out) {
+    std::vector<verdict> recs;
+    int err = honeypot_dump_table(verdict_fd, recs);
+    if (err)
+        return err;
+    out.clear();
+    for (const auto &v : recs)
+        if (v.flags & HONEYPOT_VERDICT_SHADOW)
+            out.push_back(v.src_ip);
+    return 0;
+}
+
+// CLOCK_MONOTONIC, the clock bpf_ktime_get_ns() reads.
+uint64_t monotonic_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+struct ban_policy {
+    uint64_t base;      // first offence, seconds
+    uint64_t max;       // cap for repeat offences
+    uint64_t forget;    // clean time after which the offence count resets
+};
+
+// Live bans and offence history. Every record owns exactly one wheel
+// timer: its unban while banned, its forget afterwards.
+class ban_table {
+public:
+    ban_table(ban_policy policy, uint64_t now) : policy_(policy), wheel_(now) {}
+
+    size_t active() const { return active_; }
+
+    bool is_banned(uint32_t src) const {
+        auto it = recs_.find(src);
+        return it != recs_.end() && it->second.banned;
+    }
+
+    // Bans src unless it already is; returns the ban length in seconds, or
+    // 0 when nothing changed.
+    uint64_t ban(uint32_t src) {
+        record &r = recs_[src];
+        if (r.banned)
+            return 0;
+        if (r.offences)
+            wheel_.cancel(r.timer);     // pending forget
+        r.offences++;
+        uint64_t secs = policy_.base;
+        for (uint32_t i = 1; i < r.offences && secs < policy_.max; i++)
+            secs *= 2;
+        secs = std::min(secs, policy_.max);
+        r.timer = wheel_.schedule(wheel_.now() + secs, src, kUnban);
+        r.banned = true;
+        active_++;
+        return secs;
+    }
+
+    // Advances to now and appends every source whose ban ran out.
+    void expire(uint64_t now, std::vector<uint32_t> &out) {
+        wheel_.advance(now, [&](uint32_t src, uint8_t tag) {
+            auto it = recs_.find(src);
+            if (tag == kForget) {
+                recs_.erase(it);
+                return;
+            }
+            it->second.banned = false;
+            it->second.timer = wheel_.schedule(wheel_.now() + policy_.forget, src, kForget);
+            active_--;
+            out.push_back(src);
+        });
+    }
+
+    void banned(std::vector<uint32_t> &out) const {
+        out.clear();
+        for (const auto &r : recs_)
+            if (r.second.banned)
+                out.push_back(r.first);
+    }
+
+private:
+    enum : uint8_t { kUnban, kForget };
+
+    struct record {
+        timer_wheel::handle timer = timer_wheel::kNone;
+        uint32_t            offences = 0;
+        bool                banned = false;
+    };
+
+    ban_policy                             policy_;
+    timer_wheel                            wheel_;
+    std::unordered_map<uint32_t, record>   recs_;
+    size_t                                 active_ = 0;
+};
+
+// Where bans take effect. apply() gets one tick's new bans and expiries;
+// after it fails, resync() is handed every live ban instead.
+class enforcement_backend {
+public:
+    virtual ~enforcement_backend() = default;
+    virtual const char *name() const = 0;
+    virtual int apply(const std::vector<uint32_t> &add, const std::vector<uint32_t> &del) = 0;
+    virtual int resync(const std::vector<uint32_t> &all) = 0;
+};
+
+// The XDP program already wrote the flag for every new ban, so only
+// expiries are pushed, with BPF_MAP_DELETE_BATCH. A key the LRU already
+// evicted stops the batch at that element; it is skipped and the rest
+// resubmitted.
+class verdict_backend : public enforcement_backend {
+public:
+    explicit verdict_backend(int fd) : fd_(fd) {}
+
+    const char *name() const override { return "verdict_map"; }
+
+    int apply(const std::vector<uint32_t> &, const std::vector<uint32_t> &del) override {
+        bpf_map_batch_opts opts{};
+        opts.sz = sizeof(opts);
+        size_t off = 0;
+        while (off < del.size()) {
+            uint32_t n = static_cast<uint32_t>(std::min<size_t>(del.size() - off, kHoneypotBatch));
+            if (!bpf_map_delete_batch(fd_, &del[off], &n, &opts)) {
+                off += n;
+            } else if (errno == ENOENT) {
+                off += n + 1;
+            } else {
+                return -errno;
+            }
+        }
+        return 0;
+    }
+
+    int resync(const std::vector<uint32_t> &) override { return 0; }
+
+private:
+    int fd_;
+};
+
+class nft_backend : public enforcement_backend {
+public:
+    nft_backend(std::string table, std::string set)
+        : label_(table + "/" + set), set_(NFPROTO_INET, std::move(table), std::move(set)) {}
+
+    int open() { return set_.open(); }
+
+    const char *name() const override { return label_.c_str(); }
+
+    int apply(const std::vector<uint32_t> &add, const std::vector<uint32_t> &del) override {
+        return set_.commit(add, del);
+    }
+
+    int resync(const std::vector<uint32_t> &all) override { return set_.replace(all); }
+
+private:
+    std::string label_;
+    nft_set     set_;
+};
+
+// Threshold crossings posted by the XDP program since the last batch, and
+// the kernel time each source was flagged, kept until its ban is enforced.
+struct event_queue {
+    std::vector<uint32_t>                  fresh;
+    std::unordered_map<uint32_t, uint64_t> flagged_at;
+    uint64_t                               intel_drops = 0;    // weighted by sampling
+    event_bus                             *bus = nullptr;      // --bus
+};
+
+int on_event(void *ctx, void *data, size_t size) {
+    if (size < sizeof(honeypot_event))
+        return 0;
+    auto *q = static_cast<event_queue *>(ctx);
+    const auto *ev = static_cast<const honeypot_event *>(data);
+    if (q->bus)
+        q->bus->publish(event_bus_record{ev->ts_ns, ev->src_ip, EVENT_BUS_HONEYPOT,
+                                         static_cast<uint16_t>(ev->type), ev->count, ev->weight});
+    if (ev->type == HONEYPOT_EVENT_INTEL_DROP)
+        q->intel_drops += ev->weight;
+    if (!HONEYPOT_EVENT_CRITICAL(ev->type))
+        return 0;
+    q->fresh.push_back(ev->src_ip);
+    q->flagged_at.emplace(ev->src_ip, ev->ts_ns);
+    return 0;
+}
+
+// Event path counters of every possible CPU; empty if the object predates
+// honeypot_event_stats.
+void read_event_stats(int stats_fd, std::vector<honeypot_event_stats> &out) {
+    out.assign(static_cast<size_t>(libbpf_num_possible_cpus()), honeypot_event_stats{});
+    __u32 zero = 0;
+    if (stats_fd < 0 || bpf_map_lookup_elem(stats_fd, &zero, out.data()))
+        out.clear();
+}
+
+// Time-to-mitigate: from the kernel timestamp of a threshold crossing to
+// the moment every backend holds the ban. Exported in the Prometheus text
+// format for node_exporter's textfile collector.
+class mitigation_metrics {
+public:
+    explicit mitigation_metrics(uint64_t slo_us) : slo_us_(slo_us) {}
+
+    void record(uint64_t us) {
+        latency_.record(us);
+        if (us > slo_us_)
+            breaches_++;
+    }
+
+    void banned(bool from_event) { (from_event ? bans_event_ : bans_scan_)++; }
+    void abandoned() { abandoned_++; }
+
+    // Written to a temporary file and renamed, so a scrape never sees a
+    // half-written file.
+    int write(const std::string &path, size_t active, const event_queue &events,
+              const std::vector<honeypot_event_stats> &per_cpu) const {
+        const std::string tmp = path + ".tmp";
+        FILE *f = fopen(tmp.c_str(), "we");
+        if (!f)
+            return -errno;
+        fprintf(f, "# HELP omniclaw_mitigation_latency_seconds Threshold crossing in XDP to enforcement by every backend.\n"
+                   "# TYPE omniclaw_mitigation_latency_seconds summary\n");
+        for (double q : {0.5, 0.9, 0.99, 0.999})
+            fprintf(f, "omniclaw_mitigation_latency_seconds{quantile=\"%g\"} %.6f\n", q, seconds(latency_.quantile(q)));
+        fprintf(f, "omniclaw_mitigation_latency_seconds_sum %.6f\n"
+                   "omniclaw_mitigation_latency_seconds_count %llu\n",
+                seconds(latency_.sum()), static_cast<unsigned long long>(latency_.count()));
+        fprintf(f, "# HELP omniclaw_mitigation_latency_max_seconds Slowest mitigation so far.\n"
+                   "# TYPE omniclaw_mitigation_latency_max_seconds gauge\n"
+                   "omniclaw_mitigation_latency_max_seconds %.6f\n", seconds(latency_.max()));
+        fprintf(f, "# HELP omniclaw_mitigation_slo_seconds Time-to-mitigate objective (--slo-ms).\n"
+                   "# TYPE omniclaw_mitigation_slo_seconds gauge\n"
+                   "omniclaw_mitigation_slo_seconds %.6f\n", seconds(slo_us_));
+        fprintf(f, "# HELP omniclaw_mitigation_slo_breaches_total Mitigations slower than the objective.\n"
+                   "# TYPE omniclaw_mitigation_slo_breaches_total counter\n"
+                   "omniclaw_mitigation_slo_breaches_total %llu\n", static_cast<unsigned long long>(breaches_));
+        // Whole buckets only, so the ratio errs low by at most the bucket the
+        // objective falls in; 1 until there is anything to measure.
+        double attained = latency_.count() ? static_cast<double>(latency_.count_at_or_below(slo_us_)) /
+                                                 static_cast<double>(latency_.count())
+                                           : 1.0;
+        fprintf(f, "# HELP omniclaw_mitigation_slo_attainment_ratio Share of mitigations within the objective (lower bound).\n"
+                   "# TYPE omniclaw_mitigation_slo_attainment_ratio gauge\n"
+                   "omniclaw_mitigation_slo_attainment_ratio %.6f\n", attained);
+        fprintf(f, "# HELP omniclaw_mitigation_abandoned_total Threshold events whose source was never banned.\n"
+                   "# TYPE omniclaw_mitigation_abandoned_total counter\n"
+                   "omniclaw_mitigation_abandoned_total %llu\n", static_cast<unsigned long long>(abandoned_));
+        fprintf(f, "# HELP omniclaw_bans_total Bans issued, by what noticed the source first.\n"
+                   "# TYPE omniclaw_bans_total counter\n"
+                   "omniclaw_bans_total{trigger=\"event\"} %llu\n"
+                   "omniclaw_bans_total{trigger=\"scan\"} %llu\n",
+                static_cast<unsigned long long>(bans_event_), static_cast<unsigned long long>(bans_scan_));
+        fprintf(f, "# HELP omniclaw_bans_active Sources currently banned.\n"
+                   "# TYPE omniclaw_bans_active gauge\n"
+                   "omniclaw_bans_active %zu\n", active);
+        fprintf(f, "# HELP omniclaw_intel_drops_estimated_total Packets dropped by the threat-intel blocklist, from sampled events.\n"
+                   "# TYPE omniclaw_intel_drops_estimated_total counter\n"
+                   "omniclaw_intel_drops_estimated_total %llu\n",
+                static_cast<unsigned long long>(events.intel_drops));
+        fprintf(f, "# HELP omniclaw_events_posted_total Events the XDP program submitted to its CPU's ring.\n"
+                   "# TYPE omniclaw_events_posted_total counter\n");
+        for (size_t cpu = 0; cpu < per_cpu.size(); cpu++)
+            fprintf(f, "omniclaw_events_posted_total{cpu=\"%zu\"} %llu\n", cpu,
+                    static_cast<unsigned long long>(per_cpu[cpu].posted));
+        fprintf(f, "# HELP omniclaw_events_dropped_total Events not posted: sampled out or lost to a full ring (critical_lost: threshold crossings, banned by the scan instead).\n"
+                   "# TYPE omniclaw_events_dropped_total counter\n");
+        for (size_t cpu = 0; cpu < per_cpu.size(); cpu++) {
+            const honeypot_event_stats &st = per_cpu[cpu];
+            const std::pair<const char *, __u64> reasons[] = {
+                {"sampled", st.sampled_out}, {"ring_full", st.ring_full}, {"critical_lost", st.critical_lost}};
+            for (const auto &r : reasons)
+                fprintf(f, "omniclaw_events_dropped_total{cpu=\"%zu\",reason=\"%s\"} %llu\n",
+                        cpu, r.first, static_cast<unsigned long long>(r.second));
+        }
+        int err = ferror(f) ? -EIO : 0;
+        if (fclose(f) && !err)
+            err = -errno;
+        if (!err && rename(tmp.c_str(), path.c_str()))
+            err = -errno;
+        return err;
+    }
+
+private:
+    static double seconds(uint64_t us) { return static_cast<double>(us) / 1e6; }
+
+    latency_histogram latency_;
+    uint64_t          slo_us_;
+    uint64_t          breaches_ = 0, abandoned_ = 0, bans_event_ = 0, bans_scan_ = 0;
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+    unsigned tick_ms = 1000;
+    ban_policy policy{600, 7 * 86400, 86400};
+    uint64_t slo_ms = 1000;
+    std::string table = "omniclaw", set = "offenders", metrics_path, bus_name;
+    bool use_nft = true, bad = false;
+    for (int i = 1; i < argc && !bad; i++) {
+        if (!strcmp(argv[i], "--no-nft")) {
+            use_nft = false;
+            continue;
+        }
+        if (i + 1 == argc) {
+            bad = true;
+            break;
+        }
+        const char *val = argv[++i];
+        unsigned long v;
+        // Durations stay within 32 bits so doubling a ban cannot overflow.
+        if (!strcmp(argv[i - 1], "--tick-ms") && honeypot_parse_num(val, 10, 1, 3600000, v))
+            tick_ms = static_cast<unsigned>(v);
+        else if (!strcmp(argv[i - 1], "--ban") && honeypot_parse_num(val, 10, 1, UINT32_MAX, v))
+            policy.base = v;
+        else if (!strcmp(argv[i - 1], "--ban-max") && honeypot_parse_num(val, 10, 1, UINT32_MAX, v))
+            policy.max = v;
+        else if (!strcmp(argv[i - 1], "--forget") && honeypot_parse_num(val, 10, 0, UINT32_MAX, v))
+            policy.forget = v;
+        else if (!strcmp(argv[i - 1], "--table"))
+            table = val;
+        else if (!strcmp(argv[i - 1], "--set"))
+            set = val;
+        else if (!strcmp(argv[i - 1], "--metrics"))
+            metrics_path = val;
+        else if (!strcmp(argv[i - 1], "--slo-ms") && honeypot_parse_num(val, 10, 1, UINT32_MAX, v))
+            slo_ms = v;
+        else if (!strcmp(argv[i - 1], "--bus"))
+            bus_name = val;
+        else
+            bad = true;
+    }
+    if (bad || !tick_ms || !policy.base || policy.max < policy.base) {
+        int pad = static_cast<int>(strlen(argv[0]));
+        fprintf(stderr, "usage: %s [--tick-ms <ms>] [--ban <s>] [--ban-max <s>] [--forget <s>]\n"
+                        "       %*s [--table <name>] [--set <name>] [--no-nft]\n"
+                        "       %*s [--metrics <file.prom>] [--slo-ms <ms>] [--bus <shm-name>]\n",
+                argv[0], pad, "", pad, "");
+        return 2;
+    }
+
+    int verdict_fd = bpf_obj_get(HONEYPOT_VERDICT_MAP_PIN);
+    if (verdict_fd < 0) {
+        fprintf(stderr, "[offender-controller] %s: %s (run honeypot-loader attach first)\n",
+                HONEYPOT_VERDICT_MAP_PIN, strerror(errno));
+        return 1;
+    }
+    std::vector<std::unique_ptr<enforcement_backend>> backends;
+    backends.push_back(std::make_unique<verdict_backend>(verdict_fd));
+    if (use_nft) {
+        auto nft = std::make_unique<nft_backend>(table, set);
+        int err = nft->open();
+        if (err) {
+            fprintf(stderr, "[offender-controller] netlink: %s\n", strerror(-err));
+            return 1;
+        }
+        backends.push_back(std::move(nft));
+    }
+
+    event_queue events;
+    event_bus bus;
+    if (!bus_name.empty()) {
+        int err = bus.open(bus_name.c_str(), 65536);
+        if (err) {
+            fprintf(stderr, "[offender-controller] event bus %s: %s\n", bus_name.c_str(), strerror(-err));
+            return 1;
+        }
+        events.bus = &bus;
+    }
+
+    // Without event rings (an object built before them, or none filled) bans
+    // still happen, on the periodic scan only, and go untimed.
+    int stats_fd = bpf_obj_get(HONEYPOT_EVENT_STATS_PIN);
+    std::vector<honeypot_event_stats> per_cpu;
+    ring_buffer *rb = nullptr;
+    int events_fd = bpf_obj_get(HONEYPOT_EVENTS_PIN);
+    if (events_fd >= 0)
+        rb = honeypot_open_rings(events_fd, on_event, &events);
+    if (!rb)
+        fprintf(stderr, "[offender-controller] %s: %s, scanning every %u ms only\n",
+                HONEYPOT_EVENTS_PIN, strerror(errno), tick_ms);
+
+    // Bans live only in this process: after a restart every source still
+    // flagged starts over at its first offence. A backend whose apply()
+    // failed no longer mirrors the table and is rebuilt on the next batch.
+    ban_table bans(policy, monotonic_ns() / 1000000000ull);
+    mitigation_metrics metrics(slo_ms * 1000);
+    std::vector<bool> in_sync(backends.size(), false);
+    std::vector<uint32_t> candidates, add, del, all;
+    const uint64_t tick_ns = uint64_t{tick_ms} * 1000000;
+    uint64_t next_scan = 0;
+    for (;;) {
+        // A threshold event starts a batch at once; otherwise wait for the
+        // scan, which also catches anything the ring buffer dropped.
+        uint64_t now = monotonic_ns();
+        bool scan = now >= next_scan;
+        if (!scan && events.fresh.empty()) {
+            int wait_ms = static_cast<int>((next_scan - now) / 1000000) + 1;
+            if (rb)
+                ring_buffer__poll(rb, wait_ms);
+            else
+                usleep(static_cast<useconds_t>(wait_ms) * 1000);
+            continue;
+        }
+
+        candidates.swap(events.fresh);
+        events.fresh.clear();
+        size_t from_events = candidates.size();
+        if (scan) {
+            next_scan = now + tick_ns;
+            std::vector<uint32_t> flagged;
+            int err = flagged_sources(verdict_fd, flagged);
+            if (err)
+                fprintf(stderr, "[offender-controller] verdict_map: %s\n", strerror(-err));
+            candidates.insert(candidates.end(), flagged.begin(), flagged.end());
+        }
+        add.clear();
+        del.clear();
+        for (size_t i = 0; i < candidates.size(); i++) {
+            if (bans.ban(candidates[i])) {
+                add.push_back(candidates[i]);
+                metrics.banned(i < from_events);
+            }
+        }
+        candidates.clear();
+        bans.expire(now / 1000000000ull, del);
+
+        bool enforced = true;
+        for (size_t i = 0; i < backends.size(); i++) {
+            enforcement_backend &b = *backends[i];
+            int err;
+            if (in_sync[i]) {
+                err = b.apply(add, del);
+                if (err) {
+                    fprintf(stderr, "[offender-controller] %s: %s, resyncing\n", b.name(), strerror(-err));
+                    in_sync[i] = false;
+                }
+            } else {
+                bans.banned(all);
+                err = b.resync(all);
+                if (err)
+                    fprintf(stderr, "[offender-controller] %s resync: %s\n", b.name(), strerror(-err));
+                else
+                    in_sync[i] = true;
+            }
+            enforced = enforced && !err;
+        }
+
+        // A ban counts as mitigated once every backend holds it; sources a
+        // failed backend still lacks stay pending until its resync lands.
+        if (enforced) {
+            uint64_t done = monotonic_ns();
+            for (auto it = events.flagged_at.begin(); it != events.flagged_at.end();) {
+                if (bans.is_banned(it->first)) {
+                    metrics.record(done > it->second ? (done - it->second) / 1000 : 0);
+                } else if (done - it->second < 60 * 1000000000ull) {
+                    ++it;
+                    continue;
+                } else {
+                    metrics.abandoned();
+                }
+                it = events.flagged_at.erase(it);
+            }
+        }
+
+        if (!add.empty() || !del.empty())
+            printf("[offender-controller] +%zu banned -%zu expired (%zu active)\n",
+                   add.size(), del.size(), bans.active());
+        if (scan && !metrics_path.empty()) {
+            read_event_stats(stats_fd, per_cpu);
+            int err = metrics.write(metrics_path, bans.active(), events, per_cpu);
+            if (err)
+                fprintf(stderr, "[offender-controller] %s: %s\n", metrics_path.c_str(), strerror(-err));
+        }
+    }
+}
@@ -0,0 +1,208 @@
+// modules/security/ringbuf_bench.cpp — shared vs per-CPU event ring benchmark
+// Runs the two programs of ringbuf_bench_kern.cpp with BPF_PROG_TEST_RUN
+// from 1, 2, 4 ... 64 threads, each pinned to its own CPU, so every thread
+// is a producer on a different CPU exactly like RX queues during a flood.
+// A consumer thread drains the rings the way offender-controller does
+// (ring_buffer__poll over one epoll set). Per design and producer count it
+// prints the aggregate event rate, the kernel's mean time per program run
+// and the reserve failures; a failure means the consumer fell behind, not
+// that the producer got faster.
+//
+// Build: clang++ -O2 -std=c++17 -pthread ringbuf_bench.cpp -lbpf -o ringbuf-bench
+// Usage: ringbuf-bench [ringbuf_bench.bpf.o] [--events <per producer>]   (as root)
+
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "honeypot.h"
+#include "honeypot_maps.h"
+
+namespace {
+
+const char *kDefaultObject = "ringbuf_bench.bpf.o";
+constexpr __u32 kRingBytes = 4 * 1024 * 1024;      // BENCH_RING_BYTES
+
+struct design {
+    const char  *name;
+    bpf_program *prog;
+    ring_buffer *rb;
+};
+
+struct result {
+    double   events_per_sec;
+    double   ns_per_event;
+    uint64_t consumed;
+    uint64_t drops;
+};
+
+int count_sample(void *ctx, void *, size_t) {
+    static_cast<std::atomic<uint64_t> *>(ctx)->fetch_add(1, std::memory_order_relaxed);
+    return 0;
+}
+
+int pin_to(unsigned cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+uint64_t sum_drops(int drops_fd, int ncpus, bool reset) {
+    std::vector<__u64> per_cpu(static_cast<size_t>(ncpus));
+    __u32 zero = 0;
+    uint64_t total = 0;
+    if (!bpf_map_lookup_elem(drops_fd, &zero, per_cpu.data()))
+        for (__u64 v : per_cpu)
+            total += v;
+    if (reset) {
+        std::fill(per_cpu.begin(), per_cpu.end(), 0);
+        bpf_map_update_elem(drops_fd, &zero, per_cpu.data(), BPF_ANY);
+    }
+    return total;
+}
+
+result run(const design &d, const std::vector<unsigned> &cpus, unsigned producers,
+           int events, int drops_fd, int ncpus, std::atomic<uint64_t> &consumed) {
+    sum_drops(drops_fd, ncpus, true);
+    ring_buffer__consume(d.rb);
+    consumed.store(0);
+
+    std::atomic<bool> stop{false};
+    std::thread consumer([&] {
+        pin_to(cpus[0]);    // shares CPU 0 with a producer, like the controller would
+        while (!stop.load(std::memory_order_relaxed))
+            ring_buffer__poll(d.rb, 1);
+        ring_buffer__consume(d.rb);
+    });
+
+    unsigned char pkt[64] = {};
+    std::vector<__u32> duration(producers);
+    std::atomic<unsigned> ready{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < producers; i++) {
+        threads.emplace_back([&, i] {
+            pin_to(cpus[i]);
+            bpf_test_run_opts opts{};
+            opts.sz = sizeof(opts);
+            opts.data_in = pkt;
+            opts.data_size_in = sizeof(pkt);
+            opts.repeat = events;
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire))
+                ;
+            if (bpf_prog_test_run_opts(bpf_program__fd(d.prog), &opts) == 0)
+                duration[i] = opts.duration;
+        });
+    }
+    while (ready.load() < producers)
+        ;
+    auto t0 = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto &t : threads)
+        t.join();
+    auto t1 = std::chrono::steady_clock::now();
+    stop.store(true);
+    consumer.join();
+
+    double secs = std::chrono::duration<double>(t1 - t0).count();
+    double ns = 0;
+    for (__u32 v : duration)
+        ns += v;
+    return result{static_cast<double>(events) * producers / secs, ns / producers,
+                  consumed.load(), sum_drops(drops_fd, ncpus, false)};
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const char *obj_path = kDefaultObject;
+    int events = 1000000;
+    for (int i = 1; i < argc; i++) {
+        unsigned long v;
+        if (!strcmp(argv[i], "--events") && i + 1 < argc &&
+            honeypot_parse_num(argv[i + 1], 10, 1, INT_MAX, v)) {
+            events = static_cast<int>(v);
+            i++;
+        } else if (argv[i][0] != '-') {
+            obj_path = argv[i];
+        } else {
+            fprintf(stderr, "usage: %s [%s] [--events <per producer>]\n", argv[0], kDefaultObject);
+            return 2;
+        }
+    }
+
+    int ncpus = libbpf_num_possible_cpus();
+    cpu_set_t allowed;
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    std::vector<unsigned> cpus;
+    for (unsigned c = 0; c < CPU_SETSIZE; c++)
+        if (CPU_ISSET(c, &allowed))
+            cpus.push_back(c);
+
+    bpf_object *obj = bpf_object__open_file(obj_path, nullptr);
+    if (!obj) {
+        fprintf(stderr, "[ringbuf-bench] open %s: %s\n", obj_path, strerror(errno));
+        return 1;
+    }
+    bpf_map *holder = bpf_object__find_map_by_name(obj, "percpu_rings");
+    if (holder)
+        bpf_map__set_max_entries(holder, static_cast<__u32>(ncpus));
+    int err = bpf_object__load(obj);
+    if (!err && holder)
+        err = honeypot_fill_rings(bpf_map__fd(holder), static_cast<__u32>(ncpus), kRingBytes);
+    if (err || !holder) {
+        fprintf(stderr, "[ringbuf-bench] load %s: %s\n", obj_path, strerror(err ? -err : ENOENT));
+        bpf_object__close(obj);
+        return 1;
+    }
+
+    std::atomic<uint64_t> consumed{0};
+    design designs[2] = {
+        {"shared", bpf_object__find_program_by_name(obj, "emit_shared"),
+         ring_buffer__new(bpf_object__find_map_fd_by_name(obj, "shared_ring"), count_sample, &consumed, nullptr)},
+        {"per-cpu", bpf_object__find_program_by_name(obj, "emit_percpu"),
+         honeypot_open_rings(bpf_map__fd(holder), count_sample, &consumed)},
+    };
+    for (const design &d : designs) {
+        if (!d.prog || !d.rb) {
+            fprintf(stderr, "[ringbuf-bench] %s: program or ring missing\n", d.name);
+            bpf_object__close(obj);
+            return 1;
+        }
+    }
+    int drops_fd = bpf_object__find_map_fd_by_name(obj, "bench_drops");
+
+    printf("%-8s %9s %14s %12s %12s %10s\n",
+           "design", "producers", "events/s", "ns/event", "consumed", "drops");
+    for (unsigned producers = 1; producers <= 64 && producers <= cpus.size(); producers *= 2) {
+        for (const design &d : designs) {
+            result r = run(d, cpus, producers, events, drops_fd, ncpus, consumed);
+            printf("%-8s %9u %14.0f %12.1f %12llu %10llu\n", d.name, producers,
+                   r.events_per_sec, r.ns_per_event,
+                   static_cast<unsigned long long>(r.consumed),
+                   static_cast<unsigned long long>(r.drops));
+        }
+    }
+
+    for (const design &d : designs)
+        ring_buffer__free(d.rb);
+    bpf_object__close(obj);
+    return 0;
+}
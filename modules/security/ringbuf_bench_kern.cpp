@@ -0,0 +1,74 @@
+// modules/security/ringbuf_bench_kern.cpp — BPF side of ringbuf_bench.cpp
+// Two XDP programs post the same 24-byte honeypot_event per packet: one
+// into a single ring shared by every CPU (the old honeypot_events layout),
+// one into its CPU's ring of an array-of-ringbufs (the current layout).
+// Nothing is parsed, so the measured cost is reserve + submit.
+//
+// Build: clang -O2 -target bpf -x c -c ringbuf_bench_kern.cpp -o ringbuf_bench.bpf.o
+
+#include <linux/bpf.h>
+#include <bpf/bpf_helpers.h>
+
+#include "honeypot.h"
+
+#define BENCH_RING_BYTES (4 * 1024 * 1024)
+
+struct {
+    __uint(type, BPF_MAP_TYPE_RINGBUF);
+    __uint(max_entries, BENCH_RING_BYTES);
+} shared_ring SEC(".maps");
+
+struct bench_ring {
+    __uint(type, BPF_MAP_TYPE_RINGBUF);
+    __uint(max_entries, BENCH_RING_BYTES);
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY_OF_MAPS);
+    __uint(max_entries, 1);         // set to the possible CPUs by the runner
+    __type(key, __u32);
+    __array(values, struct bench_ring);
+} percpu_rings SEC(".maps");
+
+// Reserve failures per CPU: a full ring must show up as drops, not as a
+// faster producer.
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, __u64);
+} bench_drops SEC(".maps");
+
+static __always_inline int post(void *ring) {
+    struct honeypot_event *ev = bpf_ringbuf_reserve(ring, sizeof(*ev), 0);
+    if (!ev) {
+        __u32 zero = 0;
+        __u64 *drops = bpf_map_lookup_elem(&bench_drops, &zero);
+        if (drops)
+            (*drops)++;
+        return XDP_PASS;
+    }
+    ev->ts_ns = bpf_ktime_get_ns();
+    ev->src_ip = 0;
+    ev->type = HONEYPOT_EVENT_THRESHOLD;
+    ev->count = 0;
+    ev->weight = 1;
+    bpf_ringbuf_submit(ev, 0);
+    return XDP_PASS;
+}
+
+SEC("xdp")
+int emit_shared(struct xdp_md *ctx) {
+    return post(&shared_ring);
+}
+
+SEC("xdp")
+int emit_percpu(struct xdp_md *ctx) {
+    __u32 cpu = bpf_get_smp_processor_id();
+    void *ring = bpf_map_lookup_elem(&percpu_rings, &cpu);
+    if (!ring)
+        return XDP_PASS;
+    return post(ring);
+}
+
+char _license[] SEC("license") = "GPL";
@@ -0,0 +1,317 @@
+// modules/security/threat_intel_loader.cpp — threat-intel blocklist loader
+// Parses plain-text IPv4 feeds and publishes them to the intel_bloom /
+// intel_set maps of honeypot.cpp, where listed sources are dropped before
+// they reach THRESHOLD.
+//
+// Build: clang++ -O2 -std=c++17 threat_intel_loader.cpp -lbpf -o honeypot-intel
+// Usage: honeypot-intel load <feed> [<feed> ...]
+//        honeypot-intel clear
+//
+// Feeds are one address per line; "a.b.c.d", "a.b.c.d/n" (n >= 24, expanded)
+// and trailing columns after whitespace, ',' or ';' are accepted, '#' and ';'
+// start comments. Files are mmap'd and parsed in place into two fixed batch
+// buffers, so memory stays flat however large the feed. Every load builds a
+// brand-new bloom filter and hash set, then swaps them into the pinned
+// single-slot holders; the XDP program keeps using the old generation until
+// the swap and never takes a lock.
+
+#include <arpa/inet.h>
+#include <bpf/bpf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#include "honeypot.h"
+
+namespace {
+
+constexpr uint32_t kBatch = 65536;
+constexpr int      kMinPrefix = 24;     // wider CIDRs belong in an LPM map
+
+struct feed_stats {
+    uint64_t addrs   = 0;
+    uint64_t skipped = 0;
+};
+
+struct mapped_file {
+    const char *data = nullptr;
+    size_t      size = 0;
+};
+
+int map_file(const char *path, mapped_file &mf) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -errno;
+    struct stat st{};
+    if (fstat(fd, &st)) {
+        int err = -errno;
+        close(fd);
+        return err;
+    }
+    mf.size = static_cast<size_t>(st.st_size);
+    if (mf.size) {
+        void *p = mmap(nullptr, mf.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            int err = -errno;
+            close(fd);
+            return err;
+        }
+        madvise(p, mf.size, MADV_SEQUENTIAL | MADV_WILLNEED);
+        mf.data = static_cast<const char *>(p);
+    }
+    close(fd);
+    return 0;
+}
+
+void unmap_file(mapped_file &mf) {
+    if (mf.data)
+        munmap(const_cast<char *>(mf.data), mf.size);
+    mf = {};
+}
+
+// Upper bound on entries, used to size the new maps before parsing: one per
+// line plus the largest CIDR expansion for every '/'.
+uint64_t count_entries(const mapped_file &mf) {
+    uint64_t n = 0;
+    const char *p = mf.data, *end = mf.data + mf.size;
+    while (p < end) {
+        const char *nl = static_cast<const char *>(memchr(p, '\n', end - p));
+        if (!nl)
+            nl = end;
+        n++;
+        if (memchr(p, '/', nl - p))
+            n += (1u << (32 - kMinPrefix)) - 1;
+        p = nl + 1;
+    }
+    return n;
+}
+
+// Parses an unsigned decimal of at most 3 digits, no larger than max.
+const char *parse_octet(const char *p, const char *end, unsigned max, unsigned &out) {
+    unsigned v = 0;
+    int digits = 0;
+    while (p < end && *p >= '0' && *p <= '9' && digits < 3) {
+        v = v * 10 + static_cast<unsigned>(*p - '0');
+        p++;
+        digits++;
+    }
+    if (!digits || v > max || (p < end && *p >= '0' && *p <= '9'))
+        return nullptr;
+    out = v;
+    return p;
+}
+
+bool is_field_end(char c) {
+    return c == '\n' || c == '\r' || c == ' ' || c == '\t' || c == ',' || c == ';' || c == '#';
+}
+
+// Collects keys and feed ids, flushing full batches into the new maps.
+class batch_writer {
+public:
+    batch_writer(int bloom_fd, int set_fd) : bloom_fd_(bloom_fd), set_fd_(set_fd) {}
+
+    int add(uint32_t key, uint32_t feed) {
+        keys_[n_] = key;
+        vals_[n_] = feed;
+        return ++n_ == kBatch ? flush() : 0;
+    }
+
+    int flush() {
+        if (!n_)
+            return 0;
+        bpf_map_batch_opts opts{};
+        opts.sz = sizeof(opts);
+        uint32_t count = n_;
+        if (bpf_map_update_batch(set_fd_, keys_, vals_, &count, &opts))
+            return -errno;
+        // Bloom filters have no batch op and no key; each push is one
+        // syscall hashing the value into the bitset.
+        for (uint32_t i = 0; i < n_; i++)
+            if (bpf_map_update_elem(bloom_fd_, nullptr, &keys_[i], BPF_ANY))
+                return -errno;
+        n_ = 0;
+        return 0;
+    }
+
+private:
+    int      bloom_fd_, set_fd_;
+    uint32_t n_ = 0;
+    uint32_t keys_[kBatch];
+    uint32_t vals_[kBatch];
+};
+
+int parse_feed(const mapped_file &mf, uint32_t feed, batch_writer &out, feed_stats &st) {
+    const char *p = mf.data, *end = mf.data + mf.size;
+    while (p < end) {
+        const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+        if (!eol)
+            eol = end;
+        const char *q = p;
+        p = eol + 1;
+
+        while (q < eol && (*q == ' ' || *q == '\t'))
+            q++;
+        if (q == eol || *q == '#' || *q == ';' || *q == '\r')
+            continue;
+
+        uint32_t addr = 0;
+        unsigned octet = 0, prefix = 32;
+        bool ok = true;
+        for (int i = 0; i < 4 && ok; i++) {
+            q = parse_octet(q, eol, 255, octet);
+            ok = q && (i == 3 || (q < eol && *q++ == '.'));
+            addr = addr << 8 | octet;
+        }
+        if (ok && q < eol && *q == '/') {
+            q = parse_octet(q + 1, eol, 32, prefix);
+            ok = q != nullptr;
+        }
+        if (!ok || (q < eol && !is_field_end(*q)) || prefix < kMinPrefix) {
+            st.skipped++;
+            continue;
+        }
+
+        uint32_t span = 1u << (32 - prefix);
+        addr &= ~(span - 1);
+        for (uint32_t i = 0; i < span; i++) {
+            int err = out.add(htonl(addr + i), feed);
+            if (err)
+                return err;
+            st.addrs++;
+        }
+    }
+    return 0;
+}
+
+int open_holder(const char *pin) {
+    int fd = bpf_obj_get(pin);
+    if (fd < 0)
+        fprintf(stderr, "[honeypot-intel] %s: %s (attach a honeypot.bpf.o with "
+                "intel maps first)\n", pin, strerror(errno));
+    return fd;
+}
+
+int cmd_load(int bloom_holder, int set_holder, int nfeeds, char **feeds) {
+    auto t0 = std::chrono::steady_clock::now();
+    if (nfeeds > 64) {
+        fprintf(stderr, "[honeypot-intel] at most 64 feeds per load\n");
+        return -E2BIG;
+    }
+    mapped_file files[64];
+    uint64_t entries = 0;
+    int err = 0;
+    for (int i = 0; i < nfeeds && !err; i++) {
+        err = map_file(feeds[i], files[i]);
+        if (err)
+            fprintf(stderr, "[honeypot-intel] %s: %s\n", feeds[i], strerror(-err));
+        else
+            entries += count_entries(files[i]);
+    }
+
+    int bloom_fd = -1, set_fd = -1;
+    if (!err) {
+        // Sized for the worst case, so the hash never runs out of room and
+        // the bloom filter stays at or below its designed false positive
+        // rate. The set is not preallocated; unused capacity costs nothing.
+        uint32_t cap = static_cast<uint32_t>(entries ? (entries < UINT32_MAX ? entries : UINT32_MAX) : 1);
+        bpf_map_create_opts bopts{};
+        bopts.sz = sizeof(bopts);
+        bopts.map_extra = HONEYPOT_INTEL_BLOOM_HASHES;
+        bloom_fd = bpf_map_create(BPF_MAP_TYPE_BLOOM_FILTER, "intel_bloom_gen", 0,
+                                  sizeof(uint32_t), cap, &bopts);
+        bpf_map_create_opts hopts{};
+        hopts.sz = sizeof(hopts);
+        hopts.map_flags = BPF_F_NO_PREALLOC;
+        set_fd = bpf_map_create(BPF_MAP_TYPE_HASH, "intel_set_gen", sizeof(uint32_t),
+                                sizeof(uint32_t), cap, &hopts);
+        if (bloom_fd < 0 || set_fd < 0) {
+            err = -errno;
+            fprintf(stderr, "[honeypot-intel] create maps for %u entries: %s\n",
+                    cap, strerror(errno));
+        }
+    }
+
+    feed_stats st;
+    if (!err) {
+        // 512 KiB of batch buffers; the only allocation of the whole load.
+        auto writer = std::make_unique<batch_writer>(bloom_fd, set_fd);
+        for (int i = 0; i < nfeeds && !err; i++)
+            err = parse_feed(files[i], static_cast<uint32_t>(i + 1), *writer, st);
+        if (!err)
+            err = writer->flush();
+        if (err)
+            fprintf(stderr, "[honeypot-intel] push: %s\n", strerror(-err));
+    }
+
+    if (!err) {
+        // Each holder update is a single RCU pointer swap. Between the two
+        // the program may pair the new set with the old bloom filter (or
+        // vice versa); that can only miss an entry, never block a clean IP.
+        __u32 zero = 0;
+        __u32 fd = static_cast<__u32>(set_fd);
+        if (bpf_map_update_elem(set_holder, &zero, &fd, BPF_ANY))
+            err = -errno;
+        fd = static_cast<__u32>(bloom_fd);
+        if (!err && bpf_map_update_elem(bloom_holder, &zero, &fd, BPF_ANY))
+            err = -errno;
+        if (err)
+            fprintf(stderr, "[honeypot-intel] publish: %s\n", strerror(-err));
+    }
+
+    for (int i = 0; i < nfeeds; i++)
+        unmap_file(files[i]);
+    if (bloom_fd >= 0)
+        close(bloom_fd);
+    if (set_fd >= 0)
+        close(set_fd);
+    if (!err) {
+        double ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - t0).count();
+        printf("[honeypot-intel] published %llu addresses from %d feed(s) in %.0f ms "
+               "(%llu lines skipped)\n",
+               static_cast<unsigned long long>(st.addrs), nfeeds, ms,
+               static_cast<unsigned long long>(st.skipped));
+    }
+    return err;
+}
+
+int cmd_clear(int bloom_holder, int set_holder) {
+    __u32 zero = 0;
+    // Bloom first: with no filter the program skips the set entirely.
+    if ((bpf_map_delete_elem(bloom_holder, &zero) && errno != ENOENT) ||
+        (bpf_map_delete_elem(set_holder, &zero) && errno != ENOENT)) {
+        fprintf(stderr, "[honeypot-intel] clear: %s\n", strerror(errno));
+        return -errno;
+    }
+    printf("[honeypot-intel] blocklist cleared\n");
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    bool load = argc >= 3 && !strcmp(argv[1], "load");
+    bool clear = argc == 2 && !strcmp(argv[1], "clear");
+    if (!load && !clear) {
+        fprintf(stderr, "usage: %s load <feed> [<feed> ...]\n"
+                        "       %s clear\n", argv[0], argv[0]);
+        return 2;
+    }
+    int bloom_holder = open_holder(HONEYPOT_INTEL_BLOOM_PIN);
+    int set_holder = bloom_holder < 0 ? -1 : open_holder(HONEYPOT_INTEL_SET_PIN);
+    if (set_holder < 0)
+        return 1;
+    int err = load ? cmd_load(bloom_holder, set_holder, argc - 2, argv + 2)
+                   : cmd_clear(bloom_holder, set_holder);
+    close(bloom_holder);
+    close(set_holder);
+    return err ? 1 : 0;
+}
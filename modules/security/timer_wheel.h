@@ -0,0 +1,127 @@
+// modules/security/timer_wheel.h — hierarchical timer wheel
+// Four levels of 256 slots each cover 2^32 ticks. schedule() and cancel()
+// are O(1); advance() touches one level-0 slot per tick and re-files a
+// higher-level slot every 256^n ticks, so each timer is moved at most three
+// times before it fires. Timers live in one index-linked node pool, so
+// millions of them cost two allocations, not millions. Header-only like
+// honeypot_maps.h.
+
+#ifndef OMNICLAW_TIMER_WHEEL_H
+#define OMNICLAW_TIMER_WHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class timer_wheel {
+public:
+    using handle = uint32_t;
+    static constexpr handle kNone = UINT32_MAX;
+
+    explicit timer_wheel(uint64_t now) : now_(now) {
+        nodes_.resize(kLevels * kSlots);
+        for (uint32_t i = 0; i < kLevels * kSlots; i++)
+            nodes_[i].prev = nodes_[i].next = i;    // empty slot sentinels
+    }
+
+    uint64_t now() const { return now_; }
+    size_t   size() const { return live_; }
+
+    // Arms a timer carrying (key, tag) to fire at tick `expires`; ticks at
+    // or before now() fire on the next advance().
+    handle schedule(uint64_t expires, uint32_t key, uint8_t tag = 0) {
+        uint32_t n;
+        if (!free_.empty()) {
+            n = free_.back();
+            free_.pop_back();
+        } else {
+            n = static_cast<uint32_t>(nodes_.size());
+            nodes_.emplace_back();
+        }
+        nodes_[n].expires = expires > now_ ? expires : now_ + 1;
+        nodes_[n].key = key;
+        nodes_[n].tag = tag;
+        place(n);
+        live_++;
+        return n;
+    }
+
+    void cancel(handle h) {
+        unlink(h);
+        free_.push_back(h);
+        live_--;
+    }
+
+    // Moves time forward to `now`, calling fire(key, tag) for every timer
+    // that expires on the way. fire() may schedule new timers.
+    template <typename Fire>
+    void advance(uint64_t now, Fire &&fire) {
+        while (now_ < now) {
+            now_++;
+            // Re-file the next slot of each higher level whose turn has come.
+            for (uint32_t level = 1; level < kLevels; level++) {
+                if (now_ & ((uint64_t{1} << (kBits * level)) - 1))
+                    break;
+                cascade(head(level, (now_ >> (kBits * level)) & kMask));
+            }
+            uint32_t h = head(0, now_ & kMask);
+            while (nodes_[h].next != h) {
+                uint32_t n = nodes_[h].next;
+                unlink(n);
+                free_.push_back(n);
+                live_--;
+                fire(nodes_[n].key, nodes_[n].tag);
+            }
+        }
+    }
+
+private:
+    static constexpr uint32_t kLevels = 4, kBits = 8, kSlots = 1u << kBits, kMask = kSlots - 1;
+
+    struct node {
+        uint64_t expires = 0;
+        uint32_t key = 0;
+        uint32_t prev = 0, next = 0;
+        uint8_t  tag = 0;
+    };
+
+    static uint32_t head(uint32_t level, uint64_t slot) {
+        return level * kSlots + static_cast<uint32_t>(slot);
+    }
+
+    // Files a node into the lowest level whose span covers its delay.
+    void place(uint32_t n) {
+        uint64_t expires = nodes_[n].expires;
+        uint64_t delta = expires - now_;
+        uint32_t level = 0;
+        while (level + 1 < kLevels && delta >= (uint64_t{1} << (kBits * (level + 1))))
+            level++;
+        if (level == kLevels - 1 && delta >= (uint64_t{1} << (kBits * kLevels)))
+            expires = nodes_[n].expires = now_ + (uint64_t{1} << (kBits * kLevels)) - 1;
+        uint32_t h = head(level, (expires >> (kBits * level)) & kMask);
+        nodes_[n].prev = nodes_[h].prev;
+        nodes_[n].next = h;
+        nodes_[nodes_[h].prev].next = n;
+        nodes_[h].prev = n;
+    }
+
+    void unlink(uint32_t n) {
+        nodes_[nodes_[n].prev].next = nodes_[n].next;
+        nodes_[nodes_[n].next].prev = nodes_[n].prev;
+    }
+
+    void cascade(uint32_t h) {
+        while (nodes_[h].next != h) {
+            uint32_t n = nodes_[h].next;
+            unlink(n);
+            place(n);
+        }
+    }
+
+    uint64_t              now_;
+    size_t                live_ = 0;
+    std::vector<node>     nodes_;
+    std::vector<uint32_t> free_;
+};
+
+#endif // OMNICLAW_TIMER_WHEEL_H